@@ -0,0 +1,176 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Random.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Walker / Vose pairing of the weights of one table, scaled so that they sum up to size.
+// small and large are scratch space for size indices each.
+inline void pairAliases(double* scaled,
+                        const int size,
+                        float* prob,
+                        int* alias,
+                        int* small,
+                        int* large)
+{
+  std::size_t numSmall = 0;
+  std::size_t numLarge = 0;
+
+  for (int i = 0; i < size; ++i)
+  {
+    if (scaled[i] < 1.)
+    {
+      small[numSmall++] = i;
+    }
+    else
+    {
+      large[numLarge++] = i;
+    }
+  }
+
+  while (numSmall > 0 && numLarge > 0)
+  {
+    const int s = small[--numSmall];
+    const int l = large[--numLarge];
+    prob[s] = static_cast<float>(scaled[s]);
+    alias[s] = l;
+    scaled[l] += scaled[s] - 1.;
+    if (scaled[l] < 1.)
+    {
+      small[numSmall++] = l;
+    }
+    else
+    {
+      large[numLarge++] = l;
+    }
+  }
+
+  // whatever is left over is 1 up to rounding errors
+  while (numLarge > 0)
+  {
+    const int l = large[--numLarge];
+    prob[l] = 1.f;
+    alias[l] = l;
+  }
+  while (numSmall > 0)
+  {
+    const int s = small[--numSmall];
+    prob[s] = 1.f;
+    alias[s] = s;
+  }
+}
+
+// Walker / Vose alias table over at most N outcomes. Building is O(n) without heap
+// allocations, drawing is O(1): one column and one coin flip.
+template <std::size_t N>
+class AliasTable
+{
+public:
+  AliasTable();
+
+  // Weights need not be normalised. A row without any weight draws uniformly.
+  void build(const float* weights, int size);
+  // with the sum of the weights known already
+  void build(const float* weights, int size, double sum);
+
+  template <typename Generator>
+  int operator()(Generator& generator) const;
+
+  int size() const;
+
+private:
+  std::array<float, N> mProb;
+  std::array<int, N> mAlias;
+  int mSize;
+};
+
+template <std::size_t N>
+AliasTable<N>::AliasTable()
+  : mSize(1)
+{
+  mProb.fill(1.f);
+  mAlias.fill(0);
+}
+
+template <std::size_t N>
+void AliasTable<N>::build(const float* weights, const int size)
+{
+  const int numWeights = std::max(1, std::min(size, static_cast<int>(N)));
+  double sum = 0;
+  for (int i = 0; i < numWeights; ++i)
+  {
+    sum += static_cast<double>(std::max(weights[i], 0.f));
+  }
+  build(weights, size, sum);
+}
+
+template <std::size_t N>
+void AliasTable<N>::build(const float* weights, const int size, const double sum)
+{
+  mSize = std::max(1, std::min(size, static_cast<int>(N)));
+
+  if (sum <= 0)
+  {
+    for (int i = 0; i < mSize; ++i)
+    {
+      mProb[static_cast<std::size_t>(i)] = 1.f;
+      mAlias[static_cast<std::size_t>(i)] = i;
+    }
+    return;
+  }
+
+  std::array<double, N> scaled;
+  std::array<int, N> small;
+  std::array<int, N> large;
+  for (int i = 0; i < mSize; ++i)
+  {
+    scaled[static_cast<std::size_t>(i)] =
+      static_cast<double>(std::max(weights[i], 0.f)) * mSize / sum;
+  }
+  pairAliases(scaled.data(), mSize, mProb.data(), mAlias.data(), small.data(),
+              large.data());
+}
+
+template <std::size_t N>
+template <typename Generator>
+int AliasTable<N>::operator()(Generator& generator) const
+{
+  const int i = drawBelow(generator, mSize);
+  return drawUnit(generator) < mProb[static_cast<std::size_t>(i)]
+           ? i
+           : mAlias[static_cast<std::size_t>(i)];
+}
+
+template <std::size_t N>
+int AliasTable<N>::size() const
+{
+  return mSize;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
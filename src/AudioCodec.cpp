@@ -0,0 +1,195 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AudioCodec.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <array>
+#include <climits>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const std::array<int, 3> gridBits = {{8, 16, 24}};
+
+// the coarsest grid every sample lies on, 0 if there is none
+int findGridBits(const float* samples, const int numSamples)
+{
+  for (const int bits : gridBits)
+  {
+    const float scale = static_cast<float>(1 << (bits - 1));
+    bool onGrid = true;
+    for (int i = 0; i < numSamples && onGrid; ++i)
+    {
+      const float value = samples[i] * scale;
+      onGrid = value == floorf(value) && fabsf(value) <= scale;
+    }
+    if (onGrid)
+    {
+      return bits;
+    }
+  }
+  return 0;
+}
+
+int64 predict(const int64 previous, const int64 beforePrevious)
+{
+  return 2 * previous - beforePrevious;
+}
+
+// zigzag and 7 bits per byte, so that small residuals of either sign take one byte
+void writeResidual(OutputStream& stream, const int64 residual)
+{
+  uint64 value = residual < 0 ? (static_cast<uint64>(-residual) << 1) - 1
+                              : static_cast<uint64>(residual) << 1;
+  while (value >= 0x80)
+  {
+    stream.writeByte(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  stream.writeByte(static_cast<char>(value));
+}
+
+bool readResidual(InputStream& stream, int64& residual)
+{
+  uint64 value = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+  {
+    if (stream.isExhausted())
+    {
+      return false;
+    }
+    const uint64 byte = static_cast<uint8>(stream.readByte());
+    value |= (byte & 0x7f) << shift;
+    if (byte < 0x80)
+    {
+      residual = value & 1 ? -static_cast<int64>((value + 1) >> 1)
+                           : static_cast<int64>(value >> 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+void writeCompressedAudio(OutputStream& stream, const AudioBuffer<float>& buffer)
+{
+  stream.writeInt(buffer.getNumChannels());
+  stream.writeInt(buffer.getNumSamples());
+
+  // encoded in full first, the compressor is slow when fed byte by byte
+  MemoryOutputStream encoded;
+  for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+  {
+    const float* samples = buffer.getReadPointer(channel);
+    const int bits = findGridBits(samples, buffer.getNumSamples());
+    encoded.writeByte(static_cast<char>(bits));
+
+    if (bits == 0)
+    {
+      encoded.write(samples,
+                    static_cast<std::size_t>(buffer.getNumSamples()) * sizeof(float));
+      continue;
+    }
+
+    const float scale = static_cast<float>(1 << (bits - 1));
+    int64 previous = 0;
+    int64 beforePrevious = 0;
+    for (int i = 0; i < buffer.getNumSamples(); ++i)
+    {
+      const int64 value = static_cast<int64>(samples[i] * scale);
+      writeResidual(encoded, value - predict(previous, beforePrevious));
+      beforePrevious = previous;
+      previous = value;
+    }
+  }
+
+  GZIPCompressorOutputStream zipped(&stream, 9, false);
+  zipped.write(encoded.getData(), encoded.getDataSize());
+  zipped.flush();
+}
+
+bool readCompressedAudio(InputStream& stream, AudioBuffer<float>& buffer)
+{
+  const int numChannels = stream.readInt();
+  const int numSamples = stream.readInt();
+  if (numChannels <= 0 || numSamples <= 0
+      || numSamples > INT_MAX / static_cast<int>(sizeof(float)))
+  {
+    return false;
+  }
+
+  MemoryBlock encoded;
+  GZIPDecompressorInputStream(&stream, false).readIntoMemoryBlock(encoded);
+  MemoryInputStream unzipped(encoded, false);
+
+  // every channel takes a byte and every sample at least one more, so that the counts
+  // can't claim more audio than the data holds
+  const int64 minSize = numChannels * (1 + static_cast<int64>(numSamples));
+  if (static_cast<int64>(encoded.getSize()) < minSize)
+  {
+    return false;
+  }
+
+  buffer.setSize(numChannels, numSamples);
+  for (int channel = 0; channel < numChannels; ++channel)
+  {
+    float* samples = buffer.getWritePointer(channel);
+    const int bits = static_cast<uint8>(unzipped.readByte());
+
+    if (bits == 0)
+    {
+      const int numBytes = numSamples * static_cast<int>(sizeof(float));
+      if (unzipped.read(samples, numBytes) != numBytes)
+      {
+        return false;
+      }
+      continue;
+    }
+
+    if (std::find(gridBits.begin(), gridBits.end(), bits) == gridBits.end())
+    {
+      return false;
+    }
+
+    const float scale = static_cast<float>(1 << (bits - 1));
+    int64 previous = 0;
+    int64 beforePrevious = 0;
+    for (int i = 0; i < numSamples; ++i)
+    {
+      int64 residual;
+      if (!readResidual(unzipped, residual))
+      {
+        return false;
+      }
+      const int64 value = residual + predict(previous, beforePrevious);
+      samples[i] = static_cast<float>(value) / scale;
+      beforePrevious = previous;
+      previous = value;
+    }
+  }
+  return true;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,39 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Warnings.h"
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Lossless compression for audio stored in the plug-in state. Channels whose samples all
+// lie on an 8, 16 or 24 bit grid, like those decoded from integer files, are stored as
+// the residuals of a second order predictor, other channels as raw floats. The result is
+// deflated.
+void writeCompressedAudio(OutputStream& stream, const AudioBuffer<float>& buffer);
+
+// false if the data is truncated or malformed
+bool readCompressedAudio(InputStream& stream, AudioBuffer<float>& buffer);
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,130 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "BlockStats.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+namespace
+{
+const auto relaxed = std::memory_order_relaxed;
+
+int loadBucket(const double load)
+{
+  if (load < 1)
+  {
+    return std::max(0, std::min(9, static_cast<int>(load * 10)));
+  }
+  return load < 2 ? 10 : 11;
+}
+
+} // namespace
+
+BlockStats::BlockStats()
+  : mResetRequested(false)
+{
+  clear();
+}
+
+void BlockStats::addBlock(const double seconds, const double budget)
+{
+  if (mResetRequested.exchange(false))
+  {
+    clear();
+  }
+
+  const double load = budget > 0 ? seconds / budget : 0;
+  increment(mNumBlocks);
+  if (load > 1)
+  {
+    increment(mNumOverruns);
+  }
+  increment(mHistogram[static_cast<std::size_t>(loadBucket(load))]);
+  mLastSeconds.store(seconds, relaxed);
+  mTotalSeconds.store(mTotalSeconds.load(relaxed) + seconds, relaxed);
+  mWorstSeconds.store(std::max(mWorstSeconds.load(relaxed), seconds), relaxed);
+  mLastBudget.store(budget, relaxed);
+  mWorstLoad.store(std::max(mWorstLoad.load(relaxed), load), relaxed);
+}
+
+void BlockStats::addSliceSwitch()
+{
+  increment(mNumSliceSwitches);
+}
+
+void BlockStats::addStateSwap()
+{
+  increment(mNumStateSwaps);
+}
+
+// The counts may be from either side of a block the audio thread is adding, never torn.
+BlockStatsSnapshot BlockStats::snapshot() const
+{
+  BlockStatsSnapshot result;
+  result.numBlocks = mNumBlocks.load(relaxed);
+  result.numOverruns = mNumOverruns.load(relaxed);
+  result.numSliceSwitches = mNumSliceSwitches.load(relaxed);
+  result.numStateSwaps = mNumStateSwaps.load(relaxed);
+  result.lastSeconds = mLastSeconds.load(relaxed);
+  result.meanSeconds =
+    result.numBlocks > 0 ? mTotalSeconds.load(relaxed) / result.numBlocks : 0;
+  result.worstSeconds = mWorstSeconds.load(relaxed);
+  result.lastBudget = mLastBudget.load(relaxed);
+  result.worstLoad = mWorstLoad.load(relaxed);
+  for (std::size_t i = 0; i < mHistogram.size(); ++i)
+  {
+    result.histogram[i] = mHistogram[i].load(relaxed);
+  }
+  return result;
+}
+
+// The audio thread clears the counts itself, so that it stays the only one writing them.
+void BlockStats::reset()
+{
+  mResetRequested = true;
+}
+
+// a read and a write instead of a read-modify-write, as only the audio thread counts
+void BlockStats::increment(std::atomic<uint64>& counter)
+{
+  counter.store(counter.load(relaxed) + 1, relaxed);
+}
+
+void BlockStats::clear()
+{
+  mNumBlocks.store(0, relaxed);
+  mNumOverruns.store(0, relaxed);
+  mNumSliceSwitches.store(0, relaxed);
+  mNumStateSwaps.store(0, relaxed);
+  mLastSeconds.store(0, relaxed);
+  mTotalSeconds.store(0, relaxed);
+  mWorstSeconds.store(0, relaxed);
+  mLastBudget.store(0, relaxed);
+  mWorstLoad.store(0, relaxed);
+  for (std::atomic<uint64>& bucket : mHistogram)
+  {
+    bucket.store(0, relaxed);
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,86 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Warnings.h"
+#include <array>
+#include <atomic>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Blocks taking up to 10%, 20%, .. 100% of their budget, up to twice and more than
+// twice their budget.
+const static int numLoadBuckets = 12;
+
+struct BlockStatsSnapshot
+{
+  uint64 numBlocks;
+  // blocks that took longer than the audio they rendered lasts
+  uint64 numOverruns;
+  uint64 numSliceSwitches;
+  uint64 numStateSwaps;
+  double lastSeconds;
+  double meanSeconds;
+  double worstSeconds;
+  double lastBudget;
+  // the largest share of its budget a block took
+  double worstLoad;
+  std::array<uint64, numLoadBuckets> histogram;
+};
+
+// What processBlock costs. The audio thread is the only one counting, with relaxed
+// atomics it never waits on, any thread can read the counts.
+class BlockStats
+{
+public:
+  BlockStats();
+
+  // audio thread only
+  void addBlock(double seconds, double budget);
+  void addSliceSwitch();
+  void addStateSwap();
+
+  BlockStatsSnapshot snapshot() const;
+  // the counts start over with the next block
+  void reset();
+
+private:
+  static void increment(std::atomic<uint64>& counter);
+  void clear();
+
+  std::atomic<uint64> mNumBlocks;
+  std::atomic<uint64> mNumOverruns;
+  std::atomic<uint64> mNumSliceSwitches;
+  std::atomic<uint64> mNumStateSwaps;
+  std::atomic<double> mLastSeconds;
+  std::atomic<double> mTotalSeconds;
+  std::atomic<double> mWorstSeconds;
+  std::atomic<double> mLastBudget;
+  std::atomic<double> mWorstLoad;
+  std::array<std::atomic<uint64>, numLoadBuckets> mHistogram;
+  std::atomic<bool> mResetRequested;
+};
+
+} // namespace breakov
+
+POP_WARNINGS
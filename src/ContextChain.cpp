@@ -0,0 +1,197 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ContextChain.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <cmath>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const uint64 sliceMask = (uint64(1) << contextBits) - 1;
+
+bool byTarget(const SparseChain::Transition& transition, const int target)
+{
+  return transition.target < target;
+}
+
+} // namespace
+
+uint64 contextKey(const int* slices, const int length)
+{
+  uint64 key = 0;
+  for (int i = 0; i < length; ++i)
+  {
+    key = (key << contextBits) | static_cast<uint64>(slices[i] + 1);
+  }
+  return key;
+}
+
+int contextLength(uint64 key)
+{
+  int length = 0;
+  for (; key != 0; key >>= contextBits)
+  {
+    ++length;
+  }
+  return length;
+}
+
+int contextSlice(const uint64 key)
+{
+  return static_cast<int>(key & sliceMask) - 1;
+}
+
+uint64 contextSuffix(const uint64 key)
+{
+  const int length = contextLength(key);
+  return length > 1 ? key & ((uint64(1) << (contextBits * (length - 1))) - 1) : 0;
+}
+
+bool isValidContext(uint64 key, const int numSlices)
+{
+  const int length = contextLength(key);
+  if (length < 2 || length > maxMarkovOrder)
+  {
+    return false;
+  }
+  for (; key != 0; key >>= contextBits)
+  {
+    if (!isPositiveAndBelow(contextSlice(key), numSlices))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ContextChain::Row* ContextChain::getRow(const uint64 key) const
+{
+  auto it = mRows.find(key);
+  return it != mRows.end() ? &it->second : nullptr;
+}
+
+const std::map<uint64, ContextChain::Row>& ContextChain::getRows() const
+{
+  return mRows;
+}
+
+void ContextChain::setFollow(const uint64 key, const int target, const float value)
+{
+  auto found = mRows.find(key);
+  if (found == mRows.end())
+  {
+    if (value > 0 && mRows.size() < maxNumContexts)
+    {
+      mRows[key] = {{target, value}};
+    }
+    return;
+  }
+
+  Row& row = found->second;
+  auto it = std::lower_bound(row.begin(), row.end(), target, byTarget);
+  const bool exists = it != row.end() && it->target == target;
+  if (value > 0 && exists)
+  {
+    it->value = value;
+  }
+  else if (value > 0)
+  {
+    row.insert(it, {target, value});
+  }
+  else if (exists)
+  {
+    row.erase(it);
+    if (row.empty())
+    {
+      mRows.erase(found);
+    }
+  }
+}
+
+void ContextChain::setRow(const uint64 key, Row row)
+{
+  if (row.empty())
+  {
+    clearRow(key);
+  }
+  else if (mRows.count(key) > 0 || mRows.size() < maxNumContexts)
+  {
+    mRows[key] = std::move(row);
+  }
+}
+
+void ContextChain::clearRow(const uint64 key)
+{
+  mRows.erase(key);
+}
+
+// every row as its key, its size and the target and value of every transition
+void ContextChain::write(OutputStream& stream) const
+{
+  stream.writeCompressedInt(static_cast<int>(mRows.size()));
+  for (const auto& entry : mRows)
+  {
+    stream.writeInt64(static_cast<int64>(entry.first));
+    stream.writeCompressedInt(static_cast<int>(entry.second.size()));
+    for (const SparseChain::Transition& transition : entry.second)
+    {
+      stream.writeCompressedInt(transition.target);
+      stream.writeFloat(transition.value);
+    }
+  }
+}
+
+void ContextChain::read(InputStream& stream, const int numSlices)
+{
+  mRows.clear();
+  const int numRows = stream.readCompressedInt();
+  for (int i = 0; i < numRows && !stream.isExhausted(); ++i)
+  {
+    const uint64 key = static_cast<uint64>(stream.readInt64());
+    const int size = stream.readCompressedInt();
+    if (!canHoldTransitions(stream, size))
+    {
+      return;
+    }
+    Row row;
+    for (int j = 0; j < size && !stream.isExhausted(); ++j)
+    {
+      const int target = stream.readCompressedInt();
+      const float value = stream.readFloat();
+      if (isPositiveAndBelow(target, numSlices) && value > 0 && std::isfinite(value)
+          && (row.empty() || row.back().target < target))
+      {
+        row.push_back({target, value});
+      }
+    }
+    if (isValidContext(key, numSlices))
+    {
+      setRow(key, std::move(row));
+    }
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
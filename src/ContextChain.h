@@ -0,0 +1,77 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SparseChain.h"
+#include "Warnings.h"
+#include <map>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// slices a higher order chain conditions on, the current one included
+const static int maxMarkovOrder = 3;
+
+// contexts that can have a row of their own, edits adding more are dropped
+const static int maxNumContexts = 4096;
+
+// A context is the slices a transition follows, oldest first, packed into one key with
+// contextBits per slice. Slices are stored plus one, so that no key is 0.
+const static int contextBits = 11;
+
+uint64 contextKey(const int* slices, int length);
+int contextLength(uint64 key);
+// the newest slice of a context
+int contextSlice(uint64 key);
+// the context without its oldest slice
+uint64 contextSuffix(uint64 key);
+// whether a key is a context of two to maxMarkovOrder slices, all below numSlices
+bool isValidContext(uint64 key, int numSlices);
+
+// Follow probabilities of contexts of two or more slices, for chains of a higher order.
+// Only contexts that were edited have a row, the others back off to the next shorter
+// context and finally to the follow probabilities of their newest slice.
+class ContextChain
+{
+public:
+  using Row = std::vector<SparseChain::Transition>;
+
+  const Row* getRow(uint64 key) const;
+  const std::map<uint64, Row>& getRows() const;
+  // Sets a transition of a context, adding its row if there is room. A row that loses
+  // its last transition is removed, so that the context backs off again.
+  void setFollow(uint64 key, int target, float value);
+  // adds or replaces the row of a context, if there is room for it
+  void setRow(uint64 key, Row row);
+  void clearRow(uint64 key);
+
+  void write(OutputStream& stream) const;
+  void read(InputStream& stream, int numSlices);
+
+private:
+  std::map<uint64, Row> mRows;
+};
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,85 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ContextTable.h"
+#include "Warnings.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+ContextTable::ContextTable()
+  : mKeys(numSlots, 0)
+  , mRows(numSlots, -1)
+{
+}
+
+void ContextTable::reset(const int numColumns)
+{
+  std::fill(mKeys.begin(), mKeys.end(), 0);
+  mTable.reset(numColumns);
+}
+
+bool ContextTable::addRow(const uint64 key,
+                          const int* columns,
+                          const float* weights,
+                          const int size)
+{
+  const int row = mTable.getNumRows();
+  if (row >= maxNumContexts)
+  {
+    return false;
+  }
+
+  std::size_t slot = slotOf(key);
+  while (mKeys[slot] != 0 && mKeys[slot] != key)
+  {
+    slot = (slot + 1) & (numSlots - 1);
+  }
+  mKeys[slot] = key;
+  mRows[slot] = row;
+  mTable.addRow(columns, weights, size);
+  return true;
+}
+
+int ContextTable::find(const uint64 key) const
+{
+  for (std::size_t slot = slotOf(key);; slot = (slot + 1) & (numSlots - 1))
+  {
+    if (mKeys[slot] == key)
+    {
+      return mRows[slot];
+    }
+    if (mKeys[slot] == 0)
+    {
+      return -1;
+    }
+  }
+}
+
+// Fibonacci hashing, the high bits of the product mix all bits of the key
+std::size_t ContextTable::slotOf(const uint64 key)
+{
+  return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15ull) >> (64 - slotBits));
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,75 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "ContextChain.h"
+#include "SparseAliasTable.h"
+#include "Warnings.h"
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Sampling tables for the contexts of a ContextChain, found through an open addressing
+// hash table with linear probing. The table has a fixed number of slots and is at most
+// half full, so memory stays bounded and a lookup on the audio thread takes constant
+// time.
+class ContextTable
+{
+public:
+  const static int slotBits = 13;
+  const static int numSlots = 1 << slotBits;
+
+  ContextTable();
+
+  // starts over without any contexts
+  void reset(int numColumns);
+  // Adds the row of a context. Weights need not be normalised, zero weights are left
+  // out. Returns false once all contexts have a row.
+  bool addRow(uint64 key, const int* columns, const float* weights, int size);
+  // the row of a context, or -1 if it has none
+  int find(uint64 key) const;
+
+  template <typename Generator>
+  int operator()(int row, Generator& generator) const;
+
+private:
+  static std::size_t slotOf(uint64 key);
+
+  // 0 marks an empty slot, no context has that key
+  std::vector<uint64> mKeys;
+  std::vector<int> mRows;
+  SparseAliasTable mTable;
+};
+
+static_assert(ContextTable::numSlots >= 2 * maxNumContexts,
+              "the slots of a full table are at most half taken");
+
+template <typename Generator>
+int ContextTable::operator()(const int row, Generator& generator) const
+{
+  return mTable(row, generator);
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,183 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FileLoader.h"
+#include "Warnings.h"
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+FileLoader::FileLoader()
+  : Thread("breakov loader")
+  , mHasRequest(false)
+  , mSampleRate(0)
+  , mCancel(false)
+  , mLoading(false)
+  , mProgress(0)
+{
+  startThread();
+}
+
+FileLoader::~FileLoader()
+{
+  stopThread(4000);
+}
+
+void FileLoader::load(const File& file, const String& hash)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRequest = file;
+    mRequestHash = hash;
+    mHasRequest = true;
+    mCancel = true;
+    mLoading = true;
+  }
+  notify();
+}
+
+void FileLoader::adopt(std::shared_ptr<SampleSource> original,
+                       std::shared_ptr<SampleSource> converted)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCurrent = std::move(original);
+    mConverted.clear();
+    if (converted)
+    {
+      mConverted[converted->getSampleRate()] = std::move(converted);
+    }
+  }
+  notify();
+}
+
+void FileLoader::setSampleRate(const double sampleRate)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSampleRate = sampleRate;
+  }
+  notify();
+}
+
+void FileLoader::cancel()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  mHasRequest = false;
+  mCancel = true;
+}
+
+bool FileLoader::isLoading() const
+{
+  return mLoading;
+}
+
+double FileLoader::getProgress() const
+{
+  return mProgress;
+}
+
+LoadedSource FileLoader::takeLoaded()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  LoadedSource loaded = std::move(mLoaded);
+  mLoaded = LoadedSource();
+  return loaded;
+}
+
+void FileLoader::run()
+{
+  while (!threadShouldExit())
+  {
+    File file;
+    String hash;
+    std::shared_ptr<SampleSource> original;
+    double sampleRate;
+    bool hasRequest;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      hasRequest = mHasRequest;
+      file = mRequest;
+      hash = mRequestHash;
+      sampleRate = mSampleRate;
+      if (!hasRequest && mCurrent && mConverted.count(sampleRate) == 0)
+      {
+        original = mCurrent;
+        hasRequest = true;
+      }
+      mLoading = hasRequest;
+      mHasRequest = false;
+      mCancel = false;
+      mProgress = 0;
+    }
+
+    if (!hasRequest)
+    {
+      wait(-1);
+      continue;
+    }
+
+    const LoadProgress progress = [this](const double fraction) {
+      mProgress = fraction;
+      return !mCancel && !threadShouldExit();
+    };
+
+    if (!original)
+    {
+      original = openSampleSource(file, progress);
+
+      // the file has been replaced since the hash was taken
+      if (!original || (hash.isNotEmpty() && original->getFileHash() != hash))
+      {
+        continue;
+      }
+    }
+
+    std::shared_ptr<SampleSource> source =
+      convertSampleRate(original, sampleRate, progress);
+    std::shared_ptr<const Onsets> onsets =
+      source ? detectOnsets(*source, progress) : nullptr;
+    std::shared_ptr<const ZeroCrossings> zeroCrossings =
+      source ? findZeroCrossings(*source) : nullptr;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!source || mCancel)
+    {
+      // a cancelled conversion of the current source isn't tried again
+      if (original == mCurrent && !mHasRequest)
+      {
+        mConverted[sampleRate] = original;
+      }
+      continue;
+    }
+
+    if (original != mCurrent)
+    {
+      mCurrent = original;
+      mConverted.clear();
+    }
+    mConverted[sampleRate] = source;
+    mLoaded = {std::move(original), std::move(source), std::move(onsets),
+               std::move(zeroCrossings)};
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
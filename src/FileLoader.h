@@ -0,0 +1,89 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Onsets.h"
+#include "SampleSource.h"
+#include "Warnings.h"
+#include "ZeroCrossings.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// A source as it was loaded, and the one to play, converted to the host sample rate.
+// Both are the same if no conversion was needed or possible. The onsets and zero
+// crossings are those of the source played, if it is held in memory.
+struct LoadedSource
+{
+  std::shared_ptr<SampleSource> original;
+  std::shared_ptr<SampleSource> source;
+  std::shared_ptr<const Onsets> onsets;
+  std::shared_ptr<const ZeroCrossings> zeroCrossings;
+};
+
+// Opens sample sources on a background thread and converts them to the sample rate. A
+// new request abandons the one in progress, the result is collected with takeLoaded().
+// Conversions of the current source are kept per sample rate, so that switching back
+// to a rate is immediate.
+class FileLoader : private Thread
+{
+public:
+  FileLoader();
+  ~FileLoader();
+
+  // With a hash, the file is only accepted if its contents still match it.
+  void load(const File& file, const String& hash = String());
+  // Makes a source loaded elsewhere the current one. Without a converted version, one
+  // is made in the background.
+  void adopt(std::shared_ptr<SampleSource> original,
+             std::shared_ptr<SampleSource> converted);
+  // the current source is converted again if it has no version at this rate
+  void setSampleRate(double sampleRate);
+  void cancel();
+  bool isLoading() const;
+  double getProgress() const;
+
+  // the source loaded last, or nullptrs if it has been taken already
+  LoadedSource takeLoaded();
+
+private:
+  void run() override;
+
+  std::mutex mMutex;
+  File mRequest;
+  String mRequestHash;
+  bool mHasRequest;
+  double mSampleRate;
+  std::shared_ptr<SampleSource> mCurrent;
+  std::map<double, std::shared_ptr<SampleSource>> mConverted;
+  LoadedSource mLoaded;
+  std::atomic<bool> mCancel;
+  std::atomic<bool> mLoading;
+  std::atomic<double> mProgress;
+};
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,113 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "MarkovPath.h"
+#include "Warps.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+PathRecorder::PathRecorder()
+  : mEntries(new Entry[capacity])
+  , mBegin(0)
+  , mEnd(0)
+  , mWriting(0)
+{
+}
+
+void PathRecorder::record(const Decision& decision)
+{
+  const uint64 end = mEnd.load(std::memory_order_relaxed);
+  mWriting.store(end + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Entry& entry = mEntries[static_cast<std::size_t>(end % capacity)];
+  entry.sample.store(decision.sample, std::memory_order_relaxed);
+  entry.slice.store(decision.slice, std::memory_order_relaxed);
+  entry.warp.store(decision.warp, std::memory_order_relaxed);
+  mEnd.store(end + 1, std::memory_order_release);
+}
+
+void PathRecorder::restart()
+{
+  mBegin.store(mEnd.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+// Entries the audio thread may have overwritten while they were copied are dropped
+// from the front, like a seqlock reader would retry.
+MarkovPath PathRecorder::recorded() const
+{
+  const uint64 end = mEnd.load(std::memory_order_acquire);
+  const uint64 begin = std::max(mBegin.load(std::memory_order_acquire),
+                                end - std::min<uint64>(end, capacity));
+
+  MarkovPath path;
+  path.reserve(static_cast<std::size_t>(end - begin));
+  for (uint64 i = begin; i < end; ++i)
+  {
+    const Entry& entry = mEntries[static_cast<std::size_t>(i % capacity)];
+    path.push_back({entry.sample.load(std::memory_order_relaxed),
+                    entry.slice.load(std::memory_order_relaxed),
+                    entry.warp.load(std::memory_order_relaxed)});
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64 now = mWriting.load(std::memory_order_relaxed);
+  const uint64 first = std::max(mBegin.load(std::memory_order_relaxed),
+                                now - std::min<uint64>(now, capacity));
+  path.erase(path.begin(),
+             path.begin() + static_cast<std::ptrdiff_t>(std::min(first, end) - begin));
+  return path;
+}
+
+void writePath(const MarkovPath& path, OutputStream& stream)
+{
+  for (const Decision& decision : path)
+  {
+    stream << String(decision.sample) << " " << decision.slice << " " << decision.warp
+           << "\n";
+  }
+}
+
+MarkovPath readPath(InputStream& stream)
+{
+  MarkovPath path;
+  while (!stream.isExhausted())
+  {
+    const StringArray fields =
+      StringArray::fromTokens(stream.readNextLine().trim(), " ", "");
+    if (fields.size() != 3)
+    {
+      continue;
+    }
+
+    const Decision decision{fields[0].getLargeIntValue(), fields[1].getIntValue(),
+                            fields[2].getIntValue()};
+    if (decision.slice >= 0 && decision.warp >= 0 && decision.warp < numWarps)
+    {
+      path.push_back(decision);
+    }
+  }
+  return path;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
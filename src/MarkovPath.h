@@ -0,0 +1,85 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Warnings.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// A slice and warp drawn for a voice, and the sample they were drawn at, counted from
+// where playback last started over.
+struct Decision
+{
+  int64 sample;
+  int slice;
+  int warp;
+};
+
+using MarkovPath = std::vector<Decision>;
+
+// The latest decisions of the audio thread in a ring buffer. The audio thread records
+// without waiting or allocating, other threads copy what it holds.
+class PathRecorder
+{
+public:
+  const static int capacity = 1 << 16;
+
+  PathRecorder();
+
+  // audio thread only
+  void record(const Decision& decision);
+  // forgets the decisions recorded so far, audio thread only
+  void restart();
+
+  // The decisions since the last restart, oldest first. Once there were more than
+  // capacity, only the latest ones.
+  MarkovPath recorded() const;
+
+private:
+  // relaxed atomics, so that a copy racing with the audio thread is only ever stale
+  struct Entry
+  {
+    std::atomic<int64> sample;
+    std::atomic<int> slice;
+    std::atomic<int> warp;
+  };
+
+  std::unique_ptr<Entry[]> mEntries;
+  std::atomic<uint64> mBegin;
+  std::atomic<uint64> mEnd;
+  // one past the entry being written, ahead of mEnd while it is
+  std::atomic<uint64> mWriting;
+};
+
+// one decision per line, its sample, slice and warp separated by spaces
+void writePath(const MarkovPath& path, OutputStream& stream);
+// Reads what writePath wrote. Lines that aren't a decision are skipped, slices and
+// warps that couldn't have been drawn are too.
+MarkovPath readPath(InputStream& stream);
+
+} // namespace breakov
+
+POP_WARNINGS
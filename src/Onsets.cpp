@@ -0,0 +1,331 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "Onsets.h"
+#include "Warnings.h"
+#include "Workers.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <numeric>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const int fftOrder = 10;
+const int fftSize = 1 << fftOrder;
+const int numBins = fftSize / 2;
+const int hopSize = fftSize / 4;
+// magnitudes are compressed as log(1 + compression * magnitude)
+const float compression = 100.f;
+// hops to either side a peak of the flux has to top, and to average it against
+const int peakReach = 4;
+const int meanReach = 16;
+// hops per job
+const int segmentSize = 1 << 12;
+
+// The magnitudes of the FFT of fftSize real values, computed as a complex FFT of half
+// that size of the even and odd values, with its tables computed once and shared by all
+// jobs.
+class Fft
+{
+public:
+  Fft()
+    : mReversed(numBins)
+    , mCos(numBins)
+    , mSin(numBins)
+    , mWindow(fftSize)
+  {
+    for (int i = 0; i < numBins; ++i)
+    {
+      int reversed = 0;
+      for (int bit = 0; bit < fftOrder - 1; ++bit)
+      {
+        reversed |= ((i >> bit) & 1) << (fftOrder - 2 - bit);
+      }
+      mReversed[static_cast<std::size_t>(i)] = reversed;
+
+      const double angle = 2 * double_Pi * i / fftSize;
+      mCos[static_cast<std::size_t>(i)] = static_cast<float>(cos(angle));
+      mSin[static_cast<std::size_t>(i)] = static_cast<float>(-sin(angle));
+    }
+    for (int i = 0; i < fftSize; ++i)
+    {
+      mWindow[static_cast<std::size_t>(i)] =
+        static_cast<float>(0.5 - 0.5 * cos(2 * double_Pi * i / fftSize));
+    }
+  }
+
+  // re and im are numBins values of scratch space
+  void magnitudes(const float* frame, float* re, float* im, float* magnitudes) const
+  {
+    for (int i = 0; i < numBins; ++i)
+    {
+      const int j = mReversed[static_cast<std::size_t>(i)];
+      re[j] = frame[2 * i];
+      im[j] = frame[2 * i + 1];
+    }
+
+    for (int size = 2; size <= numBins; size *= 2)
+    {
+      const int half = size / 2;
+      const std::size_t step = static_cast<std::size_t>(fftSize / size);
+      for (int start = 0; start < numBins; start += size)
+      {
+        for (int k = 0; k < half; ++k)
+        {
+          const float c = mCos[static_cast<std::size_t>(k) * step];
+          const float s = mSin[static_cast<std::size_t>(k) * step];
+          const int a = start + k;
+          const int b = a + half;
+          const float tr = re[b] * c - im[b] * s;
+          const float ti = re[b] * s + im[b] * c;
+          re[b] = re[a] - tr;
+          im[b] = im[a] - ti;
+          re[a] += tr;
+          im[a] += ti;
+        }
+      }
+    }
+
+    // the spectra of the even and the odd values, combined
+    for (int k = 0; k < numBins; ++k)
+    {
+      const int m = (numBins - k) & (numBins - 1);
+      const float evenRe = 0.5f * (re[k] + re[m]);
+      const float evenIm = 0.5f * (im[k] - im[m]);
+      const float oddRe = 0.5f * (im[k] + im[m]);
+      const float oddIm = 0.5f * (re[m] - re[k]);
+      const float c = mCos[static_cast<std::size_t>(k)];
+      const float s = mSin[static_cast<std::size_t>(k)];
+      const float xRe = evenRe + c * oddRe - s * oddIm;
+      const float xIm = evenIm + c * oddIm + s * oddRe;
+      magnitudes[k] = std::sqrt(xRe * xRe + xIm * xIm);
+    }
+  }
+
+  const float* window() const
+  {
+    return mWindow.data();
+  }
+
+private:
+  std::vector<int> mReversed;
+  std::vector<float> mCos;
+  std::vector<float> mSin;
+  std::vector<float> mWindow;
+};
+
+const Fft& fft()
+{
+  static const Fft fft;
+  return fft;
+}
+
+// The flux of hops first to last (exclusive). A frame is centred on its hop, and the
+// hop before the first is analysed as well to have something to compare it to.
+class OnsetJob : public ThreadPoolJob
+{
+public:
+  OnsetJob(const AudioBuffer<float>& buffer, int first, int last, float* flux)
+    : ThreadPoolJob("breakov onsets")
+    , mBuffer(buffer)
+    , mFirst(first)
+    , mLast(last)
+    , mFlux(flux)
+  {
+  }
+
+  JobStatus runJob() override
+  {
+    std::vector<float> frame(fftSize);
+    std::vector<float> re(numBins);
+    std::vector<float> im(numBins);
+    std::vector<float> previous(numBins);
+    std::vector<float> current(numBins);
+
+    for (int hop = mFirst - 1; hop < mLast; ++hop)
+    {
+      if (shouldExit())
+      {
+        return jobHasFinished;
+      }
+
+      readFrame(hop, frame.data());
+      fft().magnitudes(frame.data(), re.data(), im.data(), current.data());
+      for (float& magnitude : current)
+      {
+        magnitude = std::log(1 + compression * magnitude);
+      }
+
+      if (hop >= mFirst)
+      {
+        float flux = 0;
+        for (std::size_t k = 0; k < numBins; ++k)
+        {
+          flux += std::max(0.f, current[k] - previous[k]);
+        }
+        mFlux[hop] = flux;
+      }
+      std::swap(previous, current);
+    }
+    return jobHasFinished;
+  }
+
+private:
+  // the windowed channel sum around a hop, zero beyond the ends of the buffer
+  void readFrame(const int hop, float* frame) const
+  {
+    const int start = hop * hopSize - fftSize / 2;
+    const int first = std::max(0, start);
+    const int last = std::min(mBuffer.getNumSamples(), start + fftSize);
+    FloatVectorOperations::clear(frame, fftSize);
+    if (first < last)
+    {
+      for (int channel = 0; channel < mBuffer.getNumChannels(); ++channel)
+      {
+        FloatVectorOperations::add(frame + first - start,
+                                   mBuffer.getReadPointer(channel, first), last - first);
+      }
+    }
+    FloatVectorOperations::multiply(frame, fft().window(), fftSize);
+    FloatVectorOperations::multiply(
+      frame, 1.f / static_cast<float>(mBuffer.getNumChannels()), fftSize);
+  }
+
+  const AudioBuffer<float>& mBuffer;
+  int mFirst;
+  int mLast;
+  float* mFlux;
+};
+
+// Hops whose flux tops its neighbours and its moving mean. The first frame to hold an
+// onset ends less than a hop after it, so it is placed a hop before that frame's end.
+Onsets pickPeaks(const std::vector<float>& flux)
+{
+  const int numHops = static_cast<int>(flux.size());
+  Onsets onsets;
+  for (int hop = 0; hop < numHops; ++hop)
+  {
+    const float value = flux[static_cast<std::size_t>(hop)];
+    bool isPeak = value > 0;
+    for (int i = std::max(0, hop - peakReach);
+         isPeak && i <= std::min(numHops - 1, hop + peakReach); ++i)
+    {
+      const float other = flux[static_cast<std::size_t>(i)];
+      // of a plateau only the first hop counts
+      isPeak = i < hop ? other < value : other <= value;
+    }
+    if (!isPeak)
+    {
+      continue;
+    }
+
+    const int first = std::max(0, hop - meanReach);
+    const int last = std::min(numHops, hop + meanReach + 1);
+    const float mean = std::accumulate(flux.begin() + first, flux.begin() + last, 0.f)
+                       / static_cast<float>(last - first);
+    if (value > mean)
+    {
+      const int64 frame = static_cast<int64>(hop) * hopSize + fftSize / 2 - hopSize;
+      onsets.push_back({std::max<int64>(0, frame), value - mean});
+    }
+  }
+  return onsets;
+}
+
+} // namespace
+
+std::shared_ptr<const Onsets> detectOnsets(const SampleSource& source,
+                                           const LoadProgress& progress)
+{
+  const AudioBuffer<float>* buffer = source.getBuffer();
+  if (!buffer || buffer->getNumChannels() == 0)
+  {
+    return nullptr;
+  }
+
+  const int numHops = buffer->getNumSamples() / hopSize + 1;
+  std::vector<float> flux(static_cast<std::size_t>(numHops));
+
+  std::vector<std::unique_ptr<ThreadPoolJob>> jobs;
+  for (int first = 0; first < numHops; first += segmentSize)
+  {
+    jobs.emplace_back(new OnsetJob(*buffer, first, std::min(first + segmentSize, numHops),
+                                   flux.data()));
+  }
+  if (!runJobs(jobs, progress))
+  {
+    return nullptr;
+  }
+  return std::make_shared<const Onsets>(pickPeaks(flux));
+}
+
+std::vector<int64> onsetSlices(const Onsets& onsets,
+                               const int numSlices,
+                               const int64 numFrames)
+{
+  Onsets strongest;
+  std::copy_if(
+    onsets.begin(), onsets.end(), std::back_inserter(strongest),
+    [numFrames](const Onset& o) { return o.frame > 0 && o.frame < numFrames; });
+  const std::size_t numOnsets =
+    std::min(strongest.size(), static_cast<std::size_t>(std::max(0, numSlices - 1)));
+  std::partial_sort(
+    strongest.begin(), strongest.begin() + static_cast<std::ptrdiff_t>(numOnsets),
+    strongest.end(),
+    [](const Onset& a, const Onset& b) { return a.strength > b.strength; });
+
+  std::vector<int64> starts(1, 0);
+  for (std::size_t i = 0; i < numOnsets; ++i)
+  {
+    starts.push_back(strongest[i].frame);
+  }
+  std::sort(starts.begin(), starts.end());
+
+  while (static_cast<int>(starts.size()) < numSlices)
+  {
+    std::size_t longest = 0;
+    int64 longestLength = 0;
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+      const int64 end = i + 1 < starts.size() ? starts[i + 1] : numFrames;
+      if (end - starts[i] > longestLength)
+      {
+        longest = i;
+        longestLength = end - starts[i];
+      }
+    }
+    if (longestLength < 2)
+    {
+      break;
+    }
+    starts.insert(starts.begin() + static_cast<std::ptrdiff_t>(longest + 1),
+                  starts[longest] + longestLength / 2);
+  }
+  return starts;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
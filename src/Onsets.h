@@ -0,0 +1,56 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SampleSource.h"
+#include "Warnings.h"
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Where something starts in a sound file, and how much more there is of it than before.
+struct Onset
+{
+  int64 frame;
+  float strength;
+};
+
+// in the order of their frames
+using Onsets = std::vector<Onset>;
+
+// Finds the onsets in a source held in memory by spectral flux: how much the log
+// magnitudes of the channel sum rose from one FFT frame to the next, picked where it
+// peaks above its moving mean. Segments of the file are analysed in parallel on the
+// shared worker pool. Returns nullptr for streamed sources or if progress asked to stop.
+std::shared_ptr<const Onsets> detectOnsets(const SampleSource& source,
+                                           const LoadProgress& progress = nullptr);
+
+// The starts of numSlices slices of numFrames frames: the first frame and the strongest
+// onsets, in order. Without enough onsets the longest slices are halved. Returns fewer
+// starts only if there are fewer frames than slices.
+std::vector<int64> onsetSlices(const Onsets& onsets, int numSlices, int64 numFrames);
+
+} // namespace breakov
+
+POP_WARNINGS
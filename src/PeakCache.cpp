@@ -0,0 +1,126 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PeakCache.h"
+#include "Warnings.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+PeakCache::PeakCache(const int numChannels, const int64 numFrames)
+  : mNumChannels(numChannels)
+  , mNumFrames(numFrames)
+  , mNumAdded(0)
+{
+  // bins start out at zero, so that every peak reaches the centre line
+  const std::size_t numBins =
+    static_cast<std::size_t>((numFrames + baseBinSize - 1) / baseBinSize);
+  mLevels.emplace_back(static_cast<std::size_t>(numChannels),
+                       std::vector<Peak>(std::max<std::size_t>(numBins, 1), Peak{0, 0}));
+}
+
+void PeakCache::add(const AudioBuffer<float>& buffer, const int numFrames)
+{
+  for (int channel = 0; channel < mNumChannels; ++channel)
+  {
+    std::vector<Peak>& bins = mLevels[0][static_cast<std::size_t>(channel)];
+    const float* samples = buffer.getReadPointer(channel);
+
+    // in runs that end at bin boundaries
+    for (int i = 0; i < numFrames;)
+    {
+      const int64 frame = mNumAdded + i;
+      const int length = std::min(numFrames - i,
+                                  baseBinSize - static_cast<int>(frame % baseBinSize));
+      const Range<float> range =
+        FloatVectorOperations::findMinAndMax(samples + i, length);
+      Peak& bin = bins[static_cast<std::size_t>(frame / baseBinSize)];
+      bin = merge(bin, {range.getStart(), range.getEnd()});
+      i += length;
+    }
+  }
+  mNumAdded += numFrames;
+}
+
+void PeakCache::finish()
+{
+  while (mLevels.back()[0].size() > 1)
+  {
+    const std::vector<std::vector<Peak>>& below = mLevels.back();
+    std::vector<std::vector<Peak>> level(static_cast<std::size_t>(mNumChannels));
+    for (std::size_t channel = 0; channel < level.size(); ++channel)
+    {
+      const std::vector<Peak>& bins = below[channel];
+      for (std::size_t i = 0; i < bins.size(); i += 2)
+      {
+        level[channel].push_back(i + 1 < bins.size() ? merge(bins[i], bins[i + 1])
+                                                     : bins[i]);
+      }
+    }
+    mLevels.push_back(std::move(level));
+  }
+}
+
+int PeakCache::getNumChannels() const
+{
+  return mNumChannels;
+}
+
+int64 PeakCache::getNumFrames() const
+{
+  return mNumFrames;
+}
+
+PeakCache::Peak PeakCache::getPeak(const int channel, int64 first, int64 last) const
+{
+  first = jlimit<int64>(0, mNumFrames, first);
+  last = jlimit<int64>(first, mNumFrames, last);
+  if (first == last)
+  {
+    return {0, 0};
+  }
+
+  // the coarsest level at which the range still spans at least two bins
+  std::size_t level = 0;
+  int64 binSize = baseBinSize;
+  while (level + 1 < mLevels.size() && binSize * 4 <= last - first)
+  {
+    ++level;
+    binSize *= 2;
+  }
+
+  const std::vector<Peak>& bins =
+    mLevels[level][static_cast<std::size_t>(channel)];
+  Peak peak = bins[static_cast<std::size_t>(first / binSize)];
+  for (int64 bin = first / binSize + 1; bin <= (last - 1) / binSize; ++bin)
+  {
+    peak = merge(peak, bins[static_cast<std::size_t>(bin)]);
+  }
+  return peak;
+}
+
+PeakCache::Peak PeakCache::merge(const Peak a, const Peak b)
+{
+  return {std::min(a.min, b.min), std::max(a.max, b.max)};
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,68 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Warnings.h"
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// A min/max pyramid over all channels of a sound file, so that painting any range costs
+// a few lookups. Level 0 holds one peak per baseBinSize frames, every level above halves
+// the resolution of the one below.
+class PeakCache
+{
+public:
+  const static int baseBinSize = 256;
+
+  struct Peak
+  {
+    float min;
+    float max;
+  };
+
+  PeakCache(int numChannels, int64 numFrames);
+
+  // Adds the first numFrames frames of the buffer after the ones added so far. The
+  // coarser levels are built by finish() once all frames are in.
+  void add(const AudioBuffer<float>& buffer, int numFrames);
+  void finish();
+
+  int getNumChannels() const;
+  int64 getNumFrames() const;
+
+  // the extremes of a channel over frames first to last (exclusive)
+  Peak getPeak(int channel, int64 first, int64 last) const;
+
+private:
+  static Peak merge(Peak a, Peak b);
+
+  int mNumChannels;
+  int64 mNumFrames;
+  int64 mNumAdded;
+  // [level][channel][bin]
+  std::vector<std::vector<std::vector<Peak>>> mLevels;
+};
+
+} // namespace breakov
+
+POP_WARNINGS
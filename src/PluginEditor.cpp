@@ -18,7 +18,9 @@
 #include "PluginEditor.h"
 #include "PluginProcessor.h"
 #include "Warnings.h"
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <random>
 
 PUSH_WARNINGS
@@ -28,19 +30,50 @@ namespace breakov
 
 namespace
 {
+// every count up to the parameter slices, then half octave steps
 StringArray sliceNames()
 {
   StringArray sliceNames;
-  for (int i = 1; i <= maxNumSlices; ++i)
+  for (int i = 1; i <= numParameterSlices; ++i)
   {
     sliceNames.add(String(i));
   }
+  for (int i = numParameterSlices; i < maxNumSlices; i *= 2)
+  {
+    sliceNames.add(String(i * 3 / 2));
+    sliceNames.add(String(i * 2));
+  }
   return sliceNames;
 }
 
+StringArray orderNames()
+{
+  StringArray orderNames;
+  for (int i = 1; i <= maxMarkovOrder; ++i)
+  {
+    orderNames.add(String(i));
+  }
+  return orderNames;
+}
+
+// the slices of a context before its newest one, counted from 1
+String contextText(const uint64 context)
+{
+  String text;
+  for (int i = contextLength(context) - 1; i > 0; --i)
+  {
+    text << (text.isEmpty() ? " after " : ", ")
+         << contextSlice(context >> (contextBits * i)) + 1;
+  }
+  return text;
+}
+
+// transitions a randomized row of the sparse chain gets
+const int numRandomTransitions = 8;
+
 Colour getSliceColour(const int slice, const int numSlices)
 {
-  const uint8 fac = static_cast<uint8>(static_cast<int>(UINT8_MAX) / numSlices * slice);
+  const uint8 fac = static_cast<uint8>(static_cast<int>(UINT8_MAX) * slice / numSlices);
   return Colour(UINT8_MAX - fac, 4 * fac, fac);
 }
 
@@ -56,6 +89,26 @@ float getRandomValue()
   return fmodf(distribution(generator()), 1.f);
 }
 
+String embedButtonText(const bool embed)
+{
+  return embed ? "save audio in project" : "save file path only";
+}
+
+String replayButtonText(const bool replaying)
+{
+  return replaying ? "stop replaying" : "replay path";
+}
+
+String statsButtonText(const bool shown)
+{
+  return shown ? "hide performance" : "show performance";
+}
+
+String microseconds(const double seconds)
+{
+  return String(roundToInt(seconds * 1e6)) + " us";
+}
+
 } // namespace
 
 WaveDisplay::WaveDisplay(Editor& e)
@@ -68,146 +121,232 @@ void WaveDisplay::paint(Graphics& g)
 {
   const int numSlices = mEditor.processor().getNumSlices();
   StatePtr state = mEditor.state();
-  const double sliceWidth =
-    static_cast<double>(getWidth()) / static_cast<double>(numSlices);
-  const int iSliceWidth = static_cast<int>(sliceWidth + 1);
+  const std::vector<double> edges = getSliceEdges(numSlices);
 
   g.fillAll(Colours::black);
 
   g.setColour(Colours::grey);
-  g.fillRect(static_cast<int>(mEditor.slice() * sliceWidth), 0, iSliceWidth, getHeight());
+  const std::size_t slice =
+    static_cast<std::size_t>(jlimit(0, numSlices - 1, mEditor.slice()));
+  const int x = static_cast<int>(edges[slice]);
+  g.fillRect(x, 0, static_cast<int>(edges[slice + 1] + 1) - x, getHeight());
 
-  if (state)
+  if (state && state->original->getPeaks())
   {
-    paintBuffer(g, state, numSlices);
+    paintPeaks(g, *state->original->getPeaks(), edges);
   }
   else
   {
-    paintEmpty(g, numSlices);
+    paintEmpty(g, edges);
   }
 
-  paintGrid(g, numSlices);
+  paintGrid(g, edges);
 
   if (state)
   {
     g.setColour(Colours::lightgrey);
-    const int x = static_cast<int>(state->currentSliceIndex * sliceWidth + 1);
-    g.drawRect(x, 0, iSliceWidth, getHeight());
+    const std::size_t current = static_cast<std::size_t>(
+      jlimit(0, numSlices - 1, mEditor.processor().getCurrentSliceIndex()));
+    const int first = static_cast<int>(edges[current] + 1);
+    g.drawRect(first, 0, static_cast<int>(edges[current + 1] + 1) - first + 1,
+               getHeight());
+  }
+
+  if (mEditor.processor().isLoading())
+  {
+    paintProgress(g, mEditor.processor().getLoadingProgress());
   }
 }
 
-void WaveDisplay::paintGrid(Graphics& g, const int numSlices)
+void WaveDisplay::paintGrid(Graphics& g, const std::vector<double>& edges)
 {
-  const double sliceWidth =
-    static_cast<double>(getWidth()) / static_cast<double>(numSlices);
-
   g.setColour(Colours::lightgrey);
-  double i = 0;
-  while (i < getWidth())
+  for (std::size_t i = 0; i + 1 < edges.size(); ++i)
   {
-    g.drawVerticalLine(static_cast<int>(i), 0, getHeight());
-    i += sliceWidth;
+    g.drawVerticalLine(static_cast<int>(edges[i]), 0, getHeight());
   }
   g.drawVerticalLine(getWidth() - 1, 0, getHeight());
 }
 
-void WaveDisplay::paintBuffer(Graphics& g, StatePtr state, const int numSlices)
+// one lane per channel
+void WaveDisplay::paintPeaks(Graphics& g,
+                             const PeakCache& peaks,
+                             const std::vector<double>& edges)
 {
-  const double sliceWidth =
-    static_cast<double>(getWidth()) / static_cast<double>(numSlices);
+  const int numSlices = static_cast<int>(edges.size()) - 1;
+  const double framesPerLine = static_cast<double>(peaks.getNumFrames()) / getWidth();
+  const float laneHeight =
+    static_cast<float>(getHeight()) / static_cast<float>(peaks.getNumChannels());
 
-  int samplesPerLine = state->buffer.getNumSamples() / getWidth();
-  for (int i = 0; i < state->buffer.getNumSamples() && i < getWidth(); ++i)
+  int slice = 0;
+  for (int i = 0; i < getWidth(); ++i)
   {
-    float amp = 0;
-    for (int j = 0; j < samplesPerLine; j++)
+    const int64 first = static_cast<int64>(i * framesPerLine);
+    const int64 last = std::max(first + 1, static_cast<int64>((i + 1) * framesPerLine));
+
+    while (slice + 1 < numSlices && edges[static_cast<std::size_t>(slice + 1)] <= i)
     {
-      const float sample = fabsf(state->buffer.getSample(0, (i * samplesPerLine) + j));
-      amp = std::max(amp, sample);
+      ++slice;
+    }
+    g.setColour(getSliceColour(slice, numSlices));
+    for (int channel = 0; channel < peaks.getNumChannels(); ++channel)
+    {
+      const PeakCache::Peak peak = peaks.getPeak(channel, first, last);
+      const float centre = (static_cast<float>(channel) + 0.5f) * laneHeight;
+      g.drawVerticalLine(i, centre - peak.max * laneHeight / 2,
+                         centre - peak.min * laneHeight / 2);
     }
-    amp = amp / 2 * getHeight();
-
-
-    g.setColour(getSliceColour(
-      static_cast<int>(floor((static_cast<double>(i) / sliceWidth))), numSlices));
-    g.drawVerticalLine(i, getHeight() / 2 - amp, getHeight() / 2 + amp);
   }
 }
 
-void WaveDisplay::paintEmpty(Graphics& g, const int numSlices)
+void WaveDisplay::paintProgress(Graphics& g, const double progress)
+{
+  g.fillAll(Colours::black.withAlpha(0.5f));
+  g.setColour(Colours::white);
+  g.fillRect(0, getHeight() - 4, static_cast<int>(progress * getWidth()), 4);
+  g.setFont(Font("Arial", 8.0f, Font::plain));
+  g.drawText("loading", getLocalBounds(), Justification::centred);
+}
+
+void WaveDisplay::paintEmpty(Graphics& g, const std::vector<double>& edges)
 {
-  const double sliceWidth =
-    static_cast<double>(getWidth()) / static_cast<double>(numSlices);
-  const int iSliceWidth = static_cast<int>(sliceWidth + 1);
+  const int numSlices = static_cast<int>(edges.size()) - 1;
   for (int i = 0; i < numSlices; ++i)
   {
     g.setColour(getSliceColour(i, numSlices));
-    g.drawHorizontalLine(getHeight() / 2, static_cast<int>(i * sliceWidth),
-                         (i + 1) * iSliceWidth);
+    const std::size_t slice = static_cast<std::size_t>(i);
+    g.drawHorizontalLine(getHeight() / 2, static_cast<int>(edges[slice]),
+                         static_cast<int>(edges[slice + 1] + 1));
   }
 }
 
+// a shift click keeps the slices clicked before as the context of the new one
 void WaveDisplay::mouseDown(const MouseEvent& event)
 {
-  mEditor.setSlice(event.x * mEditor.processor().getNumSlices() / getWidth());
+  const std::vector<double> edges = getSliceEdges(mEditor.processor().getNumSlices());
+  const int slice = jlimit(
+    0, static_cast<int>(edges.size()) - 2,
+    static_cast<int>(std::upper_bound(edges.begin(), edges.end() - 1, event.x)
+                     - edges.begin())
+      - 1);
+  if (event.mods.isShiftDown())
+  {
+    mEditor.extendContext(slice);
+  }
+  else
+  {
+    mEditor.setSlice(slice);
+  }
+}
+
+// Where every slice starts on the display, and where the last one ends. Slices cut at
+// onsets are shown where they are, as long as the state has the number of slices asked
+// for.
+std::vector<double> WaveDisplay::getSliceEdges(const int numSlices) const
+{
+  StatePtr state = mEditor.state();
+  const double width = getWidth();
+  const int64 numFrames = state ? state->source->getNumFrames() : 0;
+  const bool isSliced = state && state->numSlices == numSlices && numFrames > 0;
+
+  std::vector<double> edges(static_cast<std::size_t>(numSlices + 1), width);
+  for (int i = 0; i < numSlices; ++i)
+  {
+    const double offset =
+      isSliced ? static_cast<double>(state->slices[static_cast<std::size_t>(i)].offset)
+                   / static_cast<double>(numFrames)
+               : static_cast<double>(i) / numSlices;
+    edges[static_cast<std::size_t>(i)] = offset * width;
+  }
+  return edges;
 }
 
-template <typename Parameters, typename GetterUtil>
-MultiSlider<Parameters, GetterUtil>::MultiSlider(Parameters& p, GetterUtil g)
-  : mParameters(p)
+template <typename GetterUtil>
+MultiSlider<GetterUtil>::MultiSlider(Processor& processor, GetterUtil g)
+  : mProcessor(processor)
   , mGetterUtil(g)
 {
   this->addMouseListener(&mMouseListener, true);
 }
 
-template <typename Parameters, typename GetterUtil>
-void MultiSlider<Parameters, GetterUtil>::paint(Graphics& g)
+// a drag cut short doesn't leave the host in a gesture
+template <typename GetterUtil>
+MultiSlider<GetterUtil>::~MultiSlider()
+{
+  mProcessor.endGesture(mDrag);
+}
+
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::paint(Graphics& g)
 {
   g.fillAll(Colours::grey);
 
   const int numSliders = mGetterUtil.numSliders();
   const int slice = mGetterUtil.slice();
-
   const float sliderWidth =
     static_cast<float>(getWidth()) / static_cast<float>(numSliders);
   const float height = getHeight();
   for (int i = 0; i < numSliders; ++i)
   {
-    g.setColour(mGetterUtil.colour(i));
-    const float val =
-      mParameters[static_cast<std::size_t>(slice)][static_cast<std::size_t>(i)]
-        ->getValue();
-    g.fillRect(i * sliderWidth, (1 - val) * height, sliderWidth, height * val);
+    const float val = mGetterUtil.value(slice, i);
+    if (val > 0)
+    {
+      g.setColour(mGetterUtil.colour(i));
+      g.fillRect(i * sliderWidth, (1 - val) * height, std::max(sliderWidth, 1.f),
+                 height * val);
+    }
   }
 
-  g.setColour(Colours::darkgrey);
-  for (int i = 1; i < numSliders; ++i)
+  // narrow sliders go without dividers
+  if (sliderWidth >= 4)
   {
-    g.drawVerticalLine(static_cast<int>(i * sliderWidth), 0, height);
+    g.setColour(Colours::darkgrey);
+    for (int i = 1; i < numSliders; ++i)
+    {
+      g.drawVerticalLine(static_cast<int>(i * sliderWidth), 0, height);
+    }
   }
 }
 
-template <typename Parameters, typename GetterUtil>
-void MultiSlider<Parameters, GetterUtil>::mouseDown(const MouseEvent& event)
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::mouseDown(const MouseEvent& event)
 {
+  mDrag.beginGesture();
   handleMouse(event.x, event.y);
+  applyDrag();
 }
 
-template <typename Parameters, typename GetterUtil>
-void MultiSlider<Parameters, GetterUtil>::mouseDrag(const MouseEvent& event)
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::mouseDrag(const MouseEvent& event)
 {
   handleMouse(event.x, event.y);
 }
 
-template <typename Parameters, typename GetterUtil>
-void MultiSlider<Parameters, GetterUtil>::handleMouse(const int x, const int y)
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::mouseUp(const MouseEvent&)
+{
+  applyDrag();
+  mProcessor.endGesture(mDrag);
+}
+
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::handleMouse(const int x, const int y)
 {
   const int numSliders = mGetterUtil.numSliders();
   const int slice = mGetterUtil.slice();
-  const int slider = x * numSliders / getWidth();
+  const int slider = jlimit(0, numSliders - 1, x * numSliders / getWidth());
   const float val = 1.f - static_cast<float>(y) / static_cast<float>(getHeight());
-  mParameters[static_cast<std::size_t>(slice)][static_cast<std::size_t>(slider)]
-    ->setValueNotifyingHost(val);
+  mGetterUtil.set(mDrag, slice, slider, val);
+}
+
+template <typename GetterUtil>
+void MultiSlider<GetterUtil>::applyDrag()
+{
+  if (!mDrag.isEmpty())
+  {
+    mProcessor.applyEdit(mDrag);
+    repaint();
+  }
 }
 
 FollowGetterUtil::FollowGetterUtil(Editor& e)
@@ -230,6 +369,122 @@ Colour FollowGetterUtil::colour(const int slice)
   return getSliceColour(slice, numSliders());
 }
 
+bool FollowGetterUtil::isSparse()
+{
+  return usesSparseChain(numSliders());
+}
+
+int FollowGetterUtil::numRows()
+{
+  return isSparse() ? numSliders() : numParameterSlices;
+}
+
+int FollowGetterUtil::rowSize()
+{
+  return numRows();
+}
+
+float FollowGetterUtil::value(const int slice, const int slider)
+{
+  if (const uint64 context = contextOf(slice))
+  {
+    return mEditor.processor().getContextFollow(context, slider);
+  }
+  return isSparse() ? mEditor.processor().getChainFollow(slice, slider)
+                    : mEditor.processor().mFollowMatrix.value(slice, slider);
+}
+
+void FollowGetterUtil::set(ParameterEdit& edit,
+                           const int slice,
+                           const int slider,
+                           const float value)
+{
+  const uint64 context = contextOf(slice);
+  if (context)
+  {
+    // a context without a row starts out with the row it backs off to
+    const bool isEdited = std::any_of(
+      edit.context.begin(), edit.context.end(),
+      [context](const ParameterEdit::ContextValue& v) { return v.context == context; });
+    if (!isEdited && !mEditor.processor().hasContextRow(context))
+    {
+      for (int i = 0; i < rowSize(); ++i)
+      {
+        const float backoff = mEditor.processor().getContextFollow(context, i);
+        if (backoff > 0)
+        {
+          edit.setContextFollow(context, i, backoff);
+        }
+      }
+    }
+    edit.setContextFollow(context, slider, value);
+  }
+  else if (isSparse())
+  {
+    edit.setFollow(slice, slider, value);
+  }
+  else
+  {
+    edit.set(mEditor.processor().pFollowProps[static_cast<std::size_t>(slice)]
+                                             [static_cast<std::size_t>(slider)],
+             value);
+  }
+}
+
+void FollowGetterUtil::clearRow(ParameterEdit& edit, const int slice)
+{
+  if (const uint64 context = contextOf(slice))
+  {
+    edit.clearContext(context);
+    return;
+  }
+  if (isSparse())
+  {
+    edit.clearFollow(slice);
+    return;
+  }
+  for (int i = 0; i < rowSize(); ++i)
+  {
+    set(edit, slice, i, 0.f);
+  }
+}
+
+// only the transitions of a sparse row
+void FollowGetterUtil::copyRow(ParameterEdit& edit, const int from, const int to)
+{
+  if (isSparse() && contextOf(from))
+  {
+    clearRow(edit, to);
+    for (int i = 0; i < rowSize(); ++i)
+    {
+      const float v = value(from, i);
+      if (v > 0)
+      {
+        set(edit, to, i, v);
+      }
+    }
+    return;
+  }
+  if (isSparse())
+  {
+    edit.clearFollow(to);
+    for (const SparseChain::Transition& t : mEditor.processor().getChainFollowRow(from))
+    {
+      edit.setFollow(to, t.target, t.value);
+    }
+    return;
+  }
+  for (int i = 0; i < rowSize(); ++i)
+  {
+    set(edit, to, i, value(from, i));
+  }
+}
+
+uint64 FollowGetterUtil::contextOf(const int slice)
+{
+  return slice == mEditor.slice() ? mEditor.context() : 0;
+}
+
 WarpGetterUtil::WarpGetterUtil(Editor& e)
   : mEditor(e)
 {
@@ -250,6 +505,60 @@ Colour WarpGetterUtil::colour(int)
   return getSliceColour(slice(), mEditor.processor().getNumSlices());
 }
 
+bool WarpGetterUtil::isSparse()
+{
+  return usesSparseChain(mEditor.processor().getNumSlices());
+}
+
+int WarpGetterUtil::numRows()
+{
+  return isSparse() ? mEditor.processor().getNumSlices() : numParameterSlices;
+}
+
+int WarpGetterUtil::rowSize()
+{
+  return numWarps;
+}
+
+float WarpGetterUtil::value(const int slice, const int slider)
+{
+  return isSparse() ? mEditor.processor().getChainWarp(slice, slider)
+                    : mEditor.processor().mWarpMatrix.value(slice, slider);
+}
+
+void WarpGetterUtil::set(ParameterEdit& edit,
+                         const int slice,
+                         const int slider,
+                         const float value)
+{
+  if (isSparse())
+  {
+    edit.setWarp(slice, slider, value);
+  }
+  else
+  {
+    edit.set(mEditor.processor().pWarpProps[static_cast<std::size_t>(slice)]
+                                           [static_cast<std::size_t>(slider)],
+             value);
+  }
+}
+
+void WarpGetterUtil::clearRow(ParameterEdit& edit, const int slice)
+{
+  for (int i = 0; i < rowSize(); ++i)
+  {
+    set(edit, slice, i, 0.f);
+  }
+}
+
+void WarpGetterUtil::copyRow(ParameterEdit& edit, const int from, const int to)
+{
+  for (int i = 0; i < rowSize(); ++i)
+  {
+    set(edit, to, i, value(from, i));
+  }
+}
+
 WarpDisplay::WarpDisplay(Warp w)
   : mWarp(w)
 {
@@ -271,7 +580,7 @@ void WarpDisplay::paint(Graphics& g)
   g.strokePath(path, PathStrokeType(1.));
 }
 
-WarpDisplays::WarpDisplays(Warps& w)
+WarpDisplays::WarpDisplays(const Warps& w)
   : mWarps(w)
 {
   for (std::size_t i = 0; i < mDisplays.size() - 1; ++i)
@@ -304,6 +613,69 @@ void WarpDisplays::paint(Graphics& g)
   }
 }
 
+StatsPanel::StatsPanel(Processor& p)
+  : mProcessor(p)
+{
+}
+
+void StatsPanel::paint(Graphics& g)
+{
+  const BlockStatsSnapshot stats = mProcessor.getBlockStats();
+
+  g.fillAll(Colours::black);
+  g.setColour(Colours::white);
+  g.setFont(Font("Arial", 8.0f, Font::plain));
+  g.drawText("blocks " + String(stats.numBlocks) + ", overruns "
+               + String(stats.numOverruns) + ", slice switches "
+               + String(stats.numSliceSwitches) + ", state swaps "
+               + String(stats.numStateSwaps),
+             5, 5, getWidth() - 10, 10, Justification::left);
+  g.drawText("last " + microseconds(stats.lastSeconds) + ", mean "
+               + microseconds(stats.meanSeconds) + ", worst "
+               + microseconds(stats.worstSeconds) + " of "
+               + microseconds(stats.lastBudget) + ", worst load "
+               + String(roundToInt(stats.worstLoad * 100)) + "%",
+             5, 18, getWidth() - 10, 10, Justification::left);
+  g.drawText("click to reset", 5, 5, getWidth() - 10, 10, Justification::right);
+
+  paintHistogram(g, stats, getLocalBounds().withTrimmedTop(35).reduced(5));
+}
+
+// Bars scale with the logarithm of the counts, so that the rare slow blocks show next
+// to the common fast ones. Those over budget are red.
+void StatsPanel::paintHistogram(Graphics& g,
+                                const BlockStatsSnapshot& stats,
+                                Rectangle<int> area)
+{
+  const Rectangle<int> labels = area.removeFromBottom(12);
+  const uint64 most = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+  const float barWidth =
+    static_cast<float>(area.getWidth()) / static_cast<float>(numLoadBuckets);
+
+  for (int i = 0; i < numLoadBuckets; ++i)
+  {
+    const uint64 count = stats.histogram[static_cast<std::size_t>(i)];
+    const double height = most > 0 ? std::log1p(static_cast<double>(count))
+                                       / std::log1p(static_cast<double>(most))
+                                   : 0;
+    const float x = static_cast<float>(area.getX()) + static_cast<float>(i) * barWidth;
+    const float barHeight = static_cast<float>(height * area.getHeight());
+
+    g.setColour(i < 10 ? Colours::white : Colours::red);
+    g.fillRect(x + 1, area.getBottom() - barHeight, barWidth - 2, barHeight);
+
+    const String label = i < 10 ? String((i + 1) * 10) + "%" : i == 10 ? "200%" : "more";
+    g.setColour(Colours::white);
+    g.drawText(label, static_cast<int>(x), labels.getY() + 2, static_cast<int>(barWidth),
+               10, Justification::centred);
+  }
+}
+
+void StatsPanel::mouseDown(const MouseEvent&)
+{
+  mProcessor.resetBlockStats();
+}
+
 void NiceLook::drawButtonBackground(
   Graphics& g, Button& b, const Colour& backgroundColour, bool, bool isButtonDown)
 {
@@ -324,32 +696,71 @@ Editor::Editor(Processor& p)
   : AudioProcessorEditor(&p)
   , mProcessor(p)
   , mSlice(0)
+  , mLoading(false)
   , mWaveDisplay(*this)
-  , mFollowSlider(p.pFollowProps, FollowGetterUtil(*this))
-  , mWarpDisplays(p.mWarps)
-  , mWarpSlider(p.pWarpProps, WarpGetterUtil(*this))
+  , mFollowSlider(p, FollowGetterUtil(*this))
+  , mWarpDisplays(warps())
+  , mWarpSlider(p, WarpGetterUtil(*this))
   , mFadeSlider(Slider::SliderStyle::LinearBar, Slider::TextEntryBoxPosition::NoTextBox)
+  , mSeedSlider(Slider::SliderStyle::IncDecButtons,
+                Slider::TextEntryBoxPosition::TextBoxLeft)
+  , mStatsPanel(p)
 {
+  mContext.fill(-1);
   addAndMakeVisible(mWaveDisplay);
   addAndMakeVisible(mFollowSlider);
   addAndMakeVisible(mWarpDisplays);
   addAndMakeVisible(mWarpSlider);
 
   textButtonSetup(mOpenButton, "open audio file");
+  textButtonSetup(mEmbedButton, embedButtonText(mProcessor.getEmbedAudio()));
 
   comboBoxSetup(mNumSlicesBox, sliceNames());
-  mNumSlicesBox.setSelectedId(mProcessor.getNumSlices(),
-                              NotificationType::dontSendNotification);
+  // the items are the counts, selected by their text
+  mNumSlicesBox.setText(String(mProcessor.getNumSlices()),
+                        NotificationType::dontSendNotification);
 
   comboBoxSetup(mSliceDurBox, sliceDurNames());
   mSliceDurBox.setSelectedId(
     static_cast<int>(*mProcessor.mParameters.getRawParameterValue("sliceDur")) + 1,
     NotificationType::dontSendNotification);
 
+  comboBoxSetup(mQualityBox, interpolationNames());
+  mQualityBox.setSelectedId(static_cast<int>(mProcessor.getInterpolation()) + 1,
+                            NotificationType::dontSendNotification);
+
+  comboBoxSetup(mOrderBox, orderNames());
+  mOrderBox.setSelectedId(mProcessor.getMarkovOrder(),
+                          NotificationType::dontSendNotification);
+
+  comboBoxSetup(mSlicingBox, slicingNames());
+  mSlicingBox.setSelectedId(static_cast<int>(mProcessor.getSlicing()) + 1,
+                            NotificationType::dontSendNotification);
+
+  comboBoxSetup(mSnapBox, edgeNames());
+  mSnapBox.setSelectedId(mProcessor.getSnapEdges() ? 2 : 1,
+                         NotificationType::dontSendNotification);
+
   sliderSetup(mFadeSlider);
   mFadeSlider.setValue(mProcessor.getFadeDuration(),
                        NotificationType::dontSendNotification);
 
+  mSeedSlider.setRange(0, maxSeed, 1);
+  mSeedSlider.setTextBoxStyle(Slider::TextEntryBoxPosition::TextBoxLeft, false, 30, 20);
+  mSeedSlider.setColour(Slider::ColourIds::textBoxTextColourId, Colours::white);
+  mSeedSlider.setColour(Slider::ColourIds::textBoxOutlineColourId, Colours::white);
+  mSeedSlider.setLookAndFeel(&mNiceLook);
+  mSeedSlider.setValue(mProcessor.getSeed(), NotificationType::dontSendNotification);
+  mSeedSlider.addListener(this);
+  addAndMakeVisible(mSeedSlider);
+
+  textButtonSetup(mSavePathButton, "save path");
+  textButtonSetup(mReplayPathButton, replayButtonText(mProcessor.isReplaying()));
+
+  // the space under the warp sliders holds the panel while it is shown
+  textButtonSetup(mStatsButton, statsButtonText(false));
+  addChildComponent(mStatsPanel);
+
   textButtonSetup(mFollowRandomizeThisButton, "randomize this slice");
   textButtonSetup(mFollowRandomizeAllButton, "randomize all slices");
   textButtonSetup(mFollowCopyToAllButton, "copy to all slices");
@@ -358,51 +769,12 @@ Editor::Editor(Processor& p)
   textButtonSetup(mWarpRandomizeAllButton, "randomize all slices");
   textButtonSetup(mWarpCopyToAllButton, "copy to all slices");
 
-  mProcessor.mParameters.addParameterListener("numSlices", this);
-  mProcessor.mParameters.addParameterListener("sliceDur", this);
-  mProcessor.mParameters.addParameterListener("fade", this);
-
-  for (int i = 0; i < maxNumSlices; ++i)
-  {
-    for (int j = 0; j < maxNumSlices; ++j)
-    {
-      mProcessor.mParameters.addParameterListener(followProbId(i, j), this);
-    }
-  }
-
-  for (int i = 0; i < maxNumSlices; ++i)
-  {
-    for (int j = 0; j < numWarps; ++j)
-    {
-      mProcessor.mParameters.addParameterListener(warpProbId(i, j), this);
-    }
-  }
-
-  setSize(600, 405);
+  setSize(600, 595);
   startTimer(30);
 }
 
 Editor::~Editor()
 {
-  mProcessor.mParameters.removeParameterListener("numSlices", this);
-  mProcessor.mParameters.removeParameterListener("sliceDur", this);
-  mProcessor.mParameters.removeParameterListener("fade", this);
-
-  for (int i = 0; i < maxNumSlices; ++i)
-  {
-    for (int j = 0; j < maxNumSlices; ++j)
-    {
-      mProcessor.mParameters.removeParameterListener(followProbId(i, j), this);
-    }
-  }
-
-  for (int i = 0; i < maxNumSlices; ++i)
-  {
-    for (int j = 0; j < numWarps; ++j)
-    {
-      mProcessor.mParameters.removeParameterListener(warpProbId(i, j), this);
-    }
-  }
 }
 
 void Editor::paint(Graphics& g)
@@ -414,13 +786,18 @@ void Editor::paint(Graphics& g)
   g.drawHorizontalLine(150, 10, getWidth() - 10);
   g.drawHorizontalLine(270, 10, getWidth() - 10);
   g.setColour(Colours::white);
-  g.drawText("follow propabilities slice " + String(mSlice + 1), 10, 140, 200, 10,
-             Justification::left);
+  g.drawText("follow propabilities slice " + String(mSlice + 1) + contextText(context()),
+             10, 140, 200, 10, Justification::left);
   g.drawText("warp propabilities slice " + String(mSlice + 1), 10, 260, 200, 10,
              Justification::left);
   g.drawText("number of slices", getWidth() - 70, 35, 60, 10, Justification::left);
   g.drawText("beats per slice", getWidth() - 70, 70, 60, 10, Justification::left);
   g.drawText("fade duration", getWidth() - 70, 105, 60, 10, Justification::left);
+  g.drawText("interpolation", getWidth() - 70, 345, 60, 10, Justification::left);
+  g.drawText("markov order", getWidth() - 70, 405, 60, 10, Justification::left);
+  g.drawText("slicing", getWidth() - 70, 440, 60, 10, Justification::left);
+  g.drawText("slice edges", getWidth() - 70, 475, 60, 10, Justification::left);
+  g.drawText("seed", getWidth() - 70, 510, 60, 10, Justification::left);
 }
 
 void Editor::resized()
@@ -440,11 +817,21 @@ void Editor::resized()
   mWarpRandomizeThisButton.setBounds(getWidth() - 70, 275, 60, 20);
   mWarpRandomizeAllButton.setBounds(getWidth() - 70, 300, 60, 20);
   mWarpCopyToAllButton.setBounds(getWidth() - 70, 325, 60, 20);
+  mQualityBox.setBounds(getWidth() - 70, 355, 60, 20);
+  mEmbedButton.setBounds(getWidth() - 70, 380, 60, 20);
+  mOrderBox.setBounds(getWidth() - 70, 415, 60, 20);
+  mSlicingBox.setBounds(getWidth() - 70, 450, 60, 20);
+  mSnapBox.setBounds(getWidth() - 70, 485, 60, 20);
+  mSeedSlider.setBounds(getWidth() - 70, 520, 60, 20);
+  mSavePathButton.setBounds(getWidth() - 70, 545, 60, 20);
+  mReplayPathButton.setBounds(getWidth() - 70, 570, 60, 20);
+  mStatsButton.setBounds(10, 410, 60, 20);
+  mStatsPanel.setBounds(10, 435, getWidth() - 100, 150);
 }
 
 StatePtr Editor::state() const
 {
-  return mProcessor.pState;
+  return mProcessor.getState();
 }
 
 const Processor& Editor::processor() const
@@ -459,10 +846,35 @@ int Editor::slice()
 
 void Editor::setSlice(int slice)
 {
+  mSlice = slice;
+  mContext.fill(-1);
+  repaint();
+}
+
+void Editor::extendContext(const int slice)
+{
+  std::copy(mContext.begin() + 1, mContext.end(), mContext.begin());
+  mContext.back() = mSlice;
   mSlice = slice;
   repaint();
 }
 
+uint64 Editor::context()
+{
+  std::array<int, maxMarkovOrder> slices;
+  std::copy(mContext.begin(), mContext.end(), slices.begin());
+  slices.back() = mSlice;
+
+  const int order = mProcessor.getMarkovOrder();
+  int length = 1;
+  while (length < order
+         && slices[static_cast<std::size_t>(maxMarkovOrder - 1 - length)] >= 0)
+  {
+    ++length;
+  }
+  return length > 1 ? contextKey(slices.data() + maxMarkovOrder - length, length) : 0;
+}
+
 void Editor::textButtonSetup(TextButton& button, String text)
 {
   button.setButtonText(text);
@@ -496,58 +908,30 @@ void Editor::sliderSetup(Slider& slider)
   addAndMakeVisible(slider);
 }
 
-void Editor::parameterChanged(const String& parameterID, float newValue)
-{
-  MessageManagerLock lock;
-
-  if (parameterID == "numSlices")
-  {
-    mNumSlicesBox.setSelectedId(static_cast<int>(newValue),
-                                NotificationType::dontSendNotification);
-
-    if (mSlice >= newValue)
-    {
-      mSlice = static_cast<int>(newValue) - 1;
-    }
-    repaint();
-  }
-  if (parameterID == "sliceDur")
-  {
-    mSliceDurBox.setSelectedId(static_cast<int>(newValue) + 1,
-                               NotificationType::dontSendNotification);
-  }
-  else if (parameterID == "fade")
-  {
-    mFadeSlider.setValue(static_cast<double>(newValue),
-                         NotificationType::dontSendNotification);
-  }
-  else if (parameterID.contains("followProb_" + String(mSlice)))
-  {
-    mFollowSlider.repaint();
-  }
-  else if (parameterID.contains("warpProb_" + String(mSlice)))
-  {
-    mWarpSlider.repaint();
-  }
-}
-
 void Editor::buttonClicked(Button* button)
 {
   if (button == &mOpenButton)
   {
-    openFile();
+    if (mProcessor.isLoading())
+    {
+      mProcessor.cancelLoading();
+    }
+    else
+    {
+      openFile();
+    }
   }
   else if (button == &mFollowRandomizeThisButton)
   {
-    randomizeThisSlice(mProcessor.pFollowProps);
+    randomizeThisSlice(mFollowSlider.mGetterUtil);
   }
   else if (button == &mFollowRandomizeAllButton)
   {
-    randomizeAllSlices(mProcessor.pFollowProps);
+    randomizeAllSlices(mFollowSlider.mGetterUtil);
   }
   else if (button == &mFollowCopyToAllButton)
   {
-    copyToAllSlices(mProcessor.pFollowProps);
+    copyToAllSlices(mFollowSlider.mGetterUtil);
   }
   else if (button == &mFollowLinearButton)
   {
@@ -555,15 +939,41 @@ void Editor::buttonClicked(Button* button)
   }
   else if (button == &mWarpRandomizeThisButton)
   {
-    randomizeThisSlice(mProcessor.pWarpProps);
+    randomizeThisSlice(mWarpSlider.mGetterUtil);
   }
   else if (button == &mWarpRandomizeAllButton)
   {
-    randomizeAllSlices(mProcessor.pWarpProps);
+    randomizeAllSlices(mWarpSlider.mGetterUtil);
   }
   else if (button == &mWarpCopyToAllButton)
   {
-    copyToAllSlices(mProcessor.pWarpProps);
+    copyToAllSlices(mWarpSlider.mGetterUtil);
+  }
+  else if (button == &mEmbedButton)
+  {
+    mProcessor.setEmbedAudio(!mProcessor.getEmbedAudio());
+    mEmbedButton.setButtonText(embedButtonText(mProcessor.getEmbedAudio()));
+  }
+  else if (button == &mSavePathButton)
+  {
+    savePath();
+  }
+  else if (button == &mReplayPathButton)
+  {
+    if (mProcessor.isReplaying())
+    {
+      mProcessor.replayPath(nullptr);
+    }
+    else
+    {
+      replayPath();
+    }
+    mReplayPathButton.setButtonText(replayButtonText(mProcessor.isReplaying()));
+  }
+  else if (button == &mStatsButton)
+  {
+    mStatsPanel.setVisible(!mStatsPanel.isVisible());
+    mStatsButton.setButtonText(statsButtonText(mStatsPanel.isVisible()));
   }
 }
 
@@ -571,9 +981,7 @@ void Editor::comboBoxChanged(ComboBox* box)
 {
   if (box == &mNumSlicesBox)
   {
-    const float value =
-      static_cast<float>(box->getSelectedId()) / static_cast<float>(maxNumSlices);
-    mProcessor.mParameters.getParameter("numSlices")->setValueNotifyingHost(value);
+    mProcessor.setNumSlices(box->getText().getIntValue());
   }
   else if (box == &mSliceDurBox)
   {
@@ -581,20 +989,124 @@ void Editor::comboBoxChanged(ComboBox* box)
       static_cast<float>(box->getSelectedId()) / static_cast<float>(sliceDurs().size());
     mProcessor.mParameters.getParameter("sliceDur")->setValueNotifyingHost(value);
   }
+  else if (box == &mQualityBox)
+  {
+    const float value = static_cast<float>(box->getSelectedId() - 1) /
+                        static_cast<float>(numInterpolations - 1);
+    mProcessor.mParameters.getParameter("quality")->setValueNotifyingHost(value);
+  }
+  else if (box == &mOrderBox)
+  {
+    const float value = static_cast<float>(box->getSelectedId() - 1) /
+                        static_cast<float>(maxMarkovOrder - 1);
+    mProcessor.mParameters.getParameter("order")->setValueNotifyingHost(value);
+  }
+  else if (box == &mSlicingBox)
+  {
+    const float value = static_cast<float>(box->getSelectedId() - 1);
+    mProcessor.mParameters.getParameter("slicing")->setValueNotifyingHost(value);
+  }
+  else if (box == &mSnapBox)
+  {
+    const float value = static_cast<float>(box->getSelectedId() - 1);
+    mProcessor.mParameters.getParameter("snap")->setValueNotifyingHost(value);
+  }
 }
 
 void Editor::sliderValueChanged(Slider* slider)
 {
-  mProcessor.mParameters.getParameter("fade")->setValueNotifyingHost(
-    static_cast<float>(slider->getValue()) / 100.f);
+  if (slider == &mFadeSlider)
+  {
+    mProcessor.mParameters.getParameter("fade")->setValueNotifyingHost(
+      static_cast<float>(slider->getValue()) / 100.f);
+  }
+  else if (slider == &mSeedSlider)
+  {
+    const float value = mProcessor.mParameters.getParameterRange("seed").convertTo0to1(
+      static_cast<float>(slider->getValue()));
+    mProcessor.mParameters.getParameter("seed")->setValueNotifyingHost(value);
+  }
 }
 
 void Editor::timerCallback()
 {
-  if (mProcessor.mStateChanged())
+  mFollowSlider.applyDrag();
+  mWarpSlider.applyDrag();
+
+  if (mStatsPanel.isVisible())
+  {
+    mStatsPanel.repaint();
+  }
+
+  const uint32 scalars = mProcessor.mParameterChanges.takeScalars();
+  if (scalars & ParameterChanges::numSlices)
+  {
+    const int numSlices = mProcessor.getNumSlices();
+    mNumSlicesBox.setText(String(numSlices), NotificationType::dontSendNotification);
+    mSlice = std::min(mSlice, numSlices - 1);
+    mContext.fill(-1);
+    repaint();
+  }
+  if (scalars & ParameterChanges::sliceDur)
+  {
+    mSliceDurBox.setSelectedId(mProcessor.getSliceDurationIndex() + 1,
+                               NotificationType::dontSendNotification);
+  }
+  if (scalars & ParameterChanges::fade)
+  {
+    mFadeSlider.setValue(mProcessor.getFadeDuration(),
+                         NotificationType::dontSendNotification);
+  }
+  if (scalars & ParameterChanges::quality)
+  {
+    mQualityBox.setSelectedId(static_cast<int>(mProcessor.getInterpolation()) + 1,
+                              NotificationType::dontSendNotification);
+  }
+  if (scalars & ParameterChanges::order)
+  {
+    mOrderBox.setSelectedId(mProcessor.getMarkovOrder(),
+                            NotificationType::dontSendNotification);
+    // the context shown is cut to the order
+    repaint();
+  }
+  if (scalars & ParameterChanges::slicing)
+  {
+    mSlicingBox.setSelectedId(static_cast<int>(mProcessor.getSlicing()) + 1,
+                              NotificationType::dontSendNotification);
+  }
+  if (scalars & ParameterChanges::snap)
+  {
+    mSnapBox.setSelectedId(mProcessor.getSnapEdges() ? 2 : 1,
+                           NotificationType::dontSendNotification);
+  }
+  if (scalars & ParameterChanges::seed)
+  {
+    mSeedSlider.setValue(mProcessor.getSeed(), NotificationType::dontSendNotification);
+  }
+
+  // the rows of the sparse chain aren't parameters and repaint when they're edited
+  const uint32 sliceBit = mSlice < numParameterSlices ? 1u << mSlice : 0;
+  if (mProcessor.mParameterChanges.takeFollowRows() & sliceBit)
+  {
+    mFollowSlider.repaint();
+  }
+  if (mProcessor.mParameterChanges.takeWarpRows() & sliceBit)
+  {
+    mWarpSlider.repaint();
+  }
+
+  const bool loading = mProcessor.isLoading();
+  if (mProcessor.mStateChanged() || loading || loading != mLoading)
   {
     mWaveDisplay.repaint();
   }
+  if (loading != mLoading)
+  {
+    mOpenButton.setButtonText(loading ? "cancel loading" : "open audio file");
+    mLoading = loading;
+  }
+  // restoring a state can change it
+  mEmbedButton.setButtonText(embedButtonText(mProcessor.getEmbedAudio()));
 }
 
 void Editor::openFile()
@@ -602,54 +1114,116 @@ void Editor::openFile()
   FileChooser chooser("Select an Audio File", File::nonexistent, "*.wav, *.aif, *.aiff");
   if (chooser.browseForFileToOpen())
   {
-    mProcessor.openFile(chooser.getResult());
+    mProcessor.loadFile(chooser.getResult());
   }
 }
 
-template <typename Parameters>
-void Editor::randomizeThisSlice(Parameters p)
+// what was played since playback last started over, to replay it later or compare it
+void Editor::savePath()
 {
-  auto& array = p[static_cast<std::size_t>(mSlice)];
-  std::for_each(array.begin(), array.end(), [](AudioProcessorParameter* par) {
-    par->setValueNotifyingHost(getRandomValue());
-  });
+  FileChooser chooser("Save the Path Played", File::nonexistent, "*.path");
+  if (chooser.browseForFileToSave(true))
+  {
+    const File file = chooser.getResult();
+    file.deleteFile();
+    FileOutputStream stream(file);
+    if (stream.openedOk())
+    {
+      writePath(mProcessor.getRecordedPath(), stream);
+    }
+  }
 }
 
-template <typename Parameters>
-void Editor::randomizeAllSlices(Parameters p)
+void Editor::replayPath()
 {
-  std::for_each(p.begin(), p.end(), [](decltype(p.front()) pars) {
-    std::for_each(pars.begin(), pars.end(), [](AudioProcessorParameter* par) {
-      par->setValueNotifyingHost(getRandomValue());
-    });
-  });
+  FileChooser chooser("Select a Path to Replay", File::nonexistent, "*.path");
+  if (chooser.browseForFileToOpen())
+  {
+    FileInputStream stream(chooser.getResult());
+    if (stream.openedOk())
+    {
+      mProcessor.replayPath(std::make_shared<const MarkovPath>(readPath(stream)));
+    }
+  }
 }
 
-template <typename Parameters>
-void Editor::copyToAllSlices(Parameters p)
+void Editor::applyEdit(ParameterEdit& edit)
 {
-  auto& data = p[static_cast<std::size_t>(mSlice)];
+  mProcessor.applyEdit(edit);
+  mFollowSlider.repaint();
+  mWarpSlider.repaint();
+}
 
-  std::for_each(p.begin(), p.end(), [&data](decltype(p.front()) pars) {
-    auto it = data.begin();
-    std::for_each(pars.begin(), pars.end(), [&it](AudioProcessorParameter* par) {
-      par->setValueNotifyingHost((*it++)->getValue());
-    });
-  });
+// Rows of the sparse chain get a few random transitions, so that they stay sparse.
+template <typename GetterUtil>
+void Editor::randomizeRow(GetterUtil& util, ParameterEdit& edit, const int slice)
+{
+  const int rowSize = util.rowSize();
+  if (rowSize <= numParameterSlices)
+  {
+    for (int i = 0; i < rowSize; ++i)
+    {
+      util.set(edit, slice, i, getRandomValue());
+    }
+    return;
+  }
+
+  std::uniform_int_distribution<int> target(0, rowSize - 1);
+  util.clearRow(edit, slice);
+  for (int i = 0; i < numRandomTransitions; ++i)
+  {
+    util.set(edit, slice, target(generator()), getRandomValue());
+  }
+}
+
+template <typename GetterUtil>
+void Editor::randomizeThisSlice(GetterUtil util)
+{
+  ParameterEdit edit;
+  randomizeRow(util, edit, mSlice);
+  applyEdit(edit);
+}
+
+template <typename GetterUtil>
+void Editor::randomizeAllSlices(GetterUtil util)
+{
+  ParameterEdit edit;
+  for (int slice = 0; slice < util.numRows(); ++slice)
+  {
+    randomizeRow(util, edit, slice);
+  }
+  applyEdit(edit);
+}
+
+template <typename GetterUtil>
+void Editor::copyToAllSlices(GetterUtil util)
+{
+  ParameterEdit edit;
+  for (int slice = 0; slice < util.numRows(); ++slice)
+  {
+    if (slice != mSlice)
+    {
+      util.copyRow(edit, mSlice, slice);
+    }
+  }
+  applyEdit(edit);
 }
 
 void Editor::setFollowChancesToLinear()
 {
+  FollowGetterUtil util(*this);
+  ParameterEdit edit;
   const int numSlices = mProcessor.getNumSlices();
-  for (int i = 0; i < maxNumSlices; ++i)
+  for (int slice = 0; slice < util.numRows(); ++slice)
   {
-    for (int j = 0; j < maxNumSlices; ++j)
+    const int next = slice == numSlices - 1 ? 0 : slice + 1;
+    util.clearRow(edit, slice);
+    if (next < util.rowSize())
     {
-      const bool set = i + 1 == j || (j == 0 && i == numSlices - 1);
-      mProcessor.pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]
-        ->setValueNotifyingHost(set ? 100 : 0);
+      util.set(edit, slice, next, 1.f);
     }
   }
+  applyEdit(edit);
 }
 
 } // namespace breakov
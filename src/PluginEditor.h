@@ -20,6 +20,7 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "PluginProcessor.h"
 #include "Warnings.h"
+#include <vector>
 
 PUSH_WARNINGS
 
@@ -32,30 +33,41 @@ struct WaveDisplay : public Component
   WaveDisplay(Editor& e);
 
   void paint(Graphics& g) override;
-  void paintGrid(Graphics& g, int numSlices);
-  void paintEmpty(Graphics& g, int numSlices);
-  void paintBuffer(Graphics& g, StatePtr state, int numSlices);
+  void paintGrid(Graphics& g, const std::vector<double>& edges);
+  void paintEmpty(Graphics& g, const std::vector<double>& edges);
+  void paintPeaks(Graphics& g, const PeakCache& peaks, const std::vector<double>& edges);
+  void paintProgress(Graphics& g, double progress);
   void mouseDown(const MouseEvent& event) override;
+  std::vector<double> getSliceEdges(int numSlices) const;
 
   Editor& mEditor;
   MouseListener mouseListener;
 };
 
-template <typename Parameters, typename GetterUtil>
+// Drags are collected and applied by the editor timer, so that a drag sends the host at
+// most one edit per tick.
+template <typename GetterUtil>
 struct MultiSlider : public Component
 {
-  MultiSlider(Parameters&, GetterUtil);
+  MultiSlider(Processor&, GetterUtil);
+  ~MultiSlider();
 
   void paint(Graphics& g) override;
   void mouseDown(const MouseEvent& event) override;
   void mouseDrag(const MouseEvent& event) override;
+  void mouseUp(const MouseEvent& event) override;
   void handleMouse(int x, int y);
+  void applyDrag();
 
-  Parameters& mParameters;
+  Processor& mProcessor;
   GetterUtil mGetterUtil;
   MouseListener mMouseListener;
+  ParameterEdit mDrag;
 };
 
+// The rows of the follow probabilities, from the parameters or, with more slices than
+// have parameters, from the sparse chain. While the editor has a context, the row of the
+// current slice is the row of that context.
 struct FollowGetterUtil
 {
   FollowGetterUtil(Editor& editor);
@@ -63,6 +75,16 @@ struct FollowGetterUtil
   int slice();
   int numSliders();
   Colour colour(int slice);
+  bool isSparse();
+  // the rows and columns that can be edited, not all of them shown
+  int numRows();
+  int rowSize();
+  float value(int slice, int slider);
+  void set(ParameterEdit& edit, int slice, int slider, float value);
+  void clearRow(ParameterEdit& edit, int slice);
+  void copyRow(ParameterEdit& edit, int from, int to);
+  // the context whose row stands in for the row of a slice, or 0
+  uint64 contextOf(int slice);
 
   Editor& mEditor;
 };
@@ -74,6 +96,13 @@ struct WarpGetterUtil
   int slice();
   int numSliders();
   Colour colour(int slice);
+  bool isSparse();
+  int numRows();
+  int rowSize();
+  float value(int slice, int slider);
+  void set(ParameterEdit& edit, int slice, int slider, float value);
+  void clearRow(ParameterEdit& edit, int slice);
+  void copyRow(ParameterEdit& edit, int from, int to);
 
   Editor& mEditor;
 };
@@ -91,14 +120,28 @@ using Warps = std::array<Warp, numWarps>;
 
 struct WarpDisplays : public Component
 {
-  WarpDisplays(Warps&);
+  WarpDisplays(const Warps&);
 
   void paint(Graphics& g) override;
 
-  Warps& mWarps;
+  const Warps& mWarps;
   std::array<std::unique_ptr<WarpDisplay>, numWarps> mDisplays;
 };
 
+// The costs of processBlock as the processor counts them: block times, overruns of
+// the block budget and a histogram of the share of the budget blocks took. A click
+// starts the counts over.
+struct StatsPanel : public Component
+{
+  StatsPanel(Processor& p);
+
+  void paint(Graphics& g) override;
+  void paintHistogram(Graphics& g, const BlockStatsSnapshot& stats, Rectangle<int> area);
+  void mouseDown(const MouseEvent& event) override;
+
+  Processor& mProcessor;
+};
+
 struct NiceLook : public LookAndFeel_V3
 {
   void drawButtonBackground(Graphics&,
@@ -120,7 +163,6 @@ struct NiceLook : public LookAndFeel_V3
 
 class Editor : public AudioProcessorEditor,
                private Timer,
-               private AudioProcessorValueTreeState::Listener,
                private Button::Listener,
                private ComboBox::Listener,
                private Slider::Listener
@@ -136,36 +178,57 @@ public:
   const Processor& processor() const;
   int slice();
   void setSlice(int);
+  // makes a slice current with the slices before it as its context
+  void extendContext(int slice);
+  // the context of the current slice up to the Markov order, 0 if there is none
+  uint64 context();
 
 private:
   void textButtonSetup(TextButton& button, String text);
   void comboBoxSetup(ComboBox& box, StringArray items);
   void sliderSetup(Slider& slider);
-  void parameterChanged(const String& parameterID, float newValue) override;
   void buttonClicked(Button* button) override;
   void comboBoxChanged(ComboBox* box) override;
   void sliderValueChanged(Slider* slider) override;
   void timerCallback() override;
   void openFile();
-  template <typename Parameters>
-  void randomizeThisSlice(Parameters);
-  template <typename Parameters>
-  void randomizeAllSlices(Parameters);
-  template <typename Parameters>
-  void copyToAllSlices(Parameters);
+  void savePath();
+  void replayPath();
+  void applyEdit(ParameterEdit& edit);
+  template <typename GetterUtil>
+  void randomizeRow(GetterUtil& util, ParameterEdit& edit, int slice);
+  template <typename GetterUtil>
+  void randomizeThisSlice(GetterUtil util);
+  template <typename GetterUtil>
+  void randomizeAllSlices(GetterUtil util);
+  template <typename GetterUtil>
+  void copyToAllSlices(GetterUtil util);
   void setFollowChancesToLinear();
 
   Processor& mProcessor;
   int mSlice;
+  // the slices before the current one, oldest first, -1 where there are none
+  std::array<int, maxMarkovOrder - 1> mContext;
+  bool mLoading;
   NiceLook mNiceLook;
   WaveDisplay mWaveDisplay;
-  MultiSlider<FollowProbs, FollowGetterUtil> mFollowSlider;
+  MultiSlider<FollowGetterUtil> mFollowSlider;
   WarpDisplays mWarpDisplays;
-  MultiSlider<WarpProbs, WarpGetterUtil> mWarpSlider;
+  MultiSlider<WarpGetterUtil> mWarpSlider;
   TextButton mOpenButton;
+  TextButton mEmbedButton;
   ComboBox mNumSlicesBox;
   ComboBox mSliceDurBox;
+  ComboBox mQualityBox;
+  ComboBox mOrderBox;
+  ComboBox mSlicingBox;
+  ComboBox mSnapBox;
   Slider mFadeSlider;
+  Slider mSeedSlider;
+  TextButton mSavePathButton;
+  TextButton mReplayPathButton;
+  TextButton mStatsButton;
+  StatsPanel mStatsPanel;
   TextButton mFollowRandomizeThisButton;
   TextButton mFollowRandomizeAllButton;
   TextButton mFollowCopyToAllButton;
@@ -16,8 +16,14 @@
  */
 
 #include "PluginProcessor.h"
+#include "AudioCodec.h"
 #include "PluginEditor.h"
 #include "Warnings.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <numeric>
 
 PUSH_WARNINGS
 
@@ -29,48 +35,120 @@ AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 namespace breakov
 {
 
-State::State(AudioBuffer<float> b,
-             const double sr,
+namespace
+{
+// slices of long streamed files may be longer than an int counts, they are cut short
+int clampSliceLength(const int64 length)
+{
+  return static_cast<int>(jlimit<int64>(1, INT_MAX, length));
+}
+} // namespace
+
+State::State(std::shared_ptr<SampleSource> o,
+             std::shared_ptr<SampleSource> s,
+             std::shared_ptr<const Onsets> t,
+             std::shared_ptr<const ZeroCrossings> z,
              const int numSlices,
-             const double fade)
-  : buffer(b)
-  , sampleRate(sr)
-  , currentSliceProgress(0)
-  , currentSliceIndex(0)
-  , currentWarpIndex(0)
-  , midiNote(-1)
+             const double fade,
+             const Slicing slicing,
+             const bool snap)
+  : original(std::move(o))
+  , source(std::move(s))
+  , onsets(std::move(t))
+  , zeroCrossings(std::move(z))
+  , numSlices(0)
+  , fadeSamples(0)
 {
-  makeSlices(numSlices, fade);
+  makeSlices(numSlices, fade, slicing, snap);
 }
 
-void State::makeSlices(const int numSlices, const double fade)
+void State::makeSlices(const int n,
+                       const double fade,
+                       const Slicing slicing,
+                       const bool snap)
 {
-  slices.clear();
-  const float fNumSamples =
-    static_cast<float>(buffer.getNumSamples()) / static_cast<float>(numSlices);
-  const int iNumSamples = static_cast<int>(fNumSamples);
-  const int numChannels = buffer.getNumChannels();
-  const int fadeSamples =
-    std::min(static_cast<int>(sampleRate / 1000 * fade), iNumSamples - 1);
-  currentSliceIndex %= numSlices;
+  numSlices = jlimit(1, maxNumSlices, n);
+  const int64 numFrames = source->getNumFrames();
+  const std::vector<int64> starts = slicing == Slicing::onsets && onsets
+                                      ? onsetSlices(*onsets, numSlices, numFrames)
+                                      : std::vector<int64>();
 
-  for (int i = 0; i < numSlices; ++i)
+  if (static_cast<int>(starts.size()) == numSlices)
+  {
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+      const int64 end = i + 1 < starts.size() ? starts[i + 1] : numFrames;
+      slices[i] = {starts[i], clampSliceLength(end - starts[i])};
+    }
+  }
+  else
   {
-    slices.push_back({numChannels, iNumSamples});
-    for (int j = 0; j < numChannels; ++j)
+    const double sliceLength =
+      static_cast<double>(numFrames) / static_cast<double>(numSlices);
+    const int length = clampSliceLength(static_cast<int64>(sliceLength));
+    for (int i = 0; i < numSlices; ++i)
     {
-      const int read = static_cast<int>(fNumSamples * static_cast<float>(i));
-      memcpy(slices.back().getWritePointer(j), buffer.getReadPointer(j, read),
-             sizeof(float) * static_cast<std::size_t>(iNumSamples));
+      slices[static_cast<std::size_t>(i)] = {static_cast<int64>(sliceLength * i), length};
     }
-    slices.back().applyGainRamp(0, fadeSamples, 0.f, 1.f);
-    slices.back().applyGainRamp(iNumSamples - fadeSamples - 1, fadeSamples, 1.f, 0.f);
   }
+
+  if (snap && zeroCrossings && source->getBuffer())
+  {
+    snapSlices();
+  }
+
+  // the fade fits the shortest slice
+  int shortest = INT_MAX;
+  for (int i = 0; i < numSlices; ++i)
+  {
+    shortest = std::min(shortest, slices[static_cast<std::size_t>(i)].length);
+  }
+  fadeSamples = std::min(floor(source->getSampleRate() / 1000 * fade),
+                         static_cast<double>(shortest - 1));
+}
+
+// Every slice but the first starts at the nearest zero crossing or quiet frame, and the
+// slice before it ends there. No slice moves past the start of another.
+void State::snapSlices()
+{
+  const AudioBuffer<float>& buffer = *source->getBuffer();
+  const int64 reach = static_cast<int64>(source->getSampleRate() / 1000 * snapReach);
+  for (std::size_t i = 1; i < static_cast<std::size_t>(numSlices); ++i)
+  {
+    Slice& before = slices[i - 1];
+    Slice& slice = slices[i];
+    const int64 end = slice.offset + slice.length;
+    const int64 first = std::max(before.offset + 1, slice.offset - reach);
+    const int64 last = std::min(end - 1, slice.offset + reach);
+    const int64 offset = snapToQuiet(buffer, *zeroCrossings, slice.offset, first, last);
+    before.length = clampSliceLength(offset - before.offset);
+    slice = {offset, clampSliceLength(end - offset)};
+  }
+}
+
+Voice::Voice()
+  : state(nullptr)
+  , sliceProgress(0)
+  , sliceIndex(0)
+  , warpIndex(0)
+  , nextSliceIndex(0)
+  , nextWarpIndex(0)
+  , midiNote(-1)
+  , pendingNote(-1)
+  , gain(0)
+  , startOrder(0)
+{
+  history.fill(-1);
+}
+
+bool Voice::isActive() const
+{
+  return midiNote != -1 || pendingNote != -1 || gain > 0;
 }
 
-bool State::isPlaying()
+float Voice::getTargetGain() const
 {
-  return midiNote != -1;
+  return midiNote != -1 && pendingNote == -1 ? 1.f : 0.f;
 }
 
 StateChanged::StateChanged()
@@ -88,6 +166,191 @@ bool StateChanged::operator()()
   return mFlag.test_and_set();
 }
 
+namespace
+{
+const char followPrefix[] = "followProb_";
+const char warpPrefix[] = "warpProb_";
+
+// The row and column of a "followProb_i_j" or "warpProb_i_j" id. Read in place, as
+// this runs on whichever thread changes a parameter.
+bool matrixCell(const String& parameterID, const char* prefix, int& row, int& column)
+{
+  if (!parameterID.startsWith(prefix))
+  {
+    return false;
+  }
+  CharPointer_UTF8 text =
+    parameterID.getCharPointer() + static_cast<int>(std::strlen(prefix));
+  row = CharacterFunctions::getIntValue<int>(text);
+  text += text.indexOf(static_cast<juce_wchar>('_')) + 1;
+  column = CharacterFunctions::getIntValue<int>(text);
+  return true;
+}
+
+} // namespace
+
+ParameterChanges::ParameterChanges()
+  : mScalars(0)
+  , mFollowRows(0)
+  , mWarpRows(0)
+{
+}
+
+// Called for every change to any parameter, possibly from the audio thread, so nothing
+// is allocated.
+void ParameterChanges::set(const String& parameterID)
+{
+  int row, column;
+  if (matrixCell(parameterID, followPrefix, row, column))
+  {
+    mFollowRows.fetch_or(1u << row);
+  }
+  else if (matrixCell(parameterID, warpPrefix, row, column))
+  {
+    mWarpRows.fetch_or(1u << row);
+  }
+  else if (parameterID == "numSlices" || parameterID == "manySlices")
+  {
+    mScalars.fetch_or(numSlices);
+  }
+  else if (parameterID == "sliceDur")
+  {
+    mScalars.fetch_or(sliceDur);
+  }
+  else if (parameterID == "fade")
+  {
+    mScalars.fetch_or(fade);
+  }
+  else if (parameterID == "quality")
+  {
+    mScalars.fetch_or(quality);
+  }
+  else if (parameterID == "order")
+  {
+    mScalars.fetch_or(order);
+  }
+  else if (parameterID == "slicing")
+  {
+    mScalars.fetch_or(slicing);
+  }
+  else if (parameterID == "snap")
+  {
+    mScalars.fetch_or(snap);
+  }
+  else if (parameterID == "seed")
+  {
+    mScalars.fetch_or(seed);
+  }
+}
+
+uint32 ParameterChanges::takeScalars()
+{
+  return mScalars.exchange(0);
+}
+
+uint32 ParameterChanges::takeFollowRows()
+{
+  return mFollowRows.exchange(0);
+}
+
+uint32 ParameterChanges::takeWarpRows()
+{
+  return mWarpRows.exchange(0);
+}
+
+ParameterEdit::ParameterEdit()
+  : isGesture(false)
+{
+}
+
+void ParameterEdit::set(AudioProcessorParameter* parameter, const float value)
+{
+  const auto index = valueIndices.emplace(parameter, values.size());
+  if (index.second)
+  {
+    values.emplace_back(parameter, value);
+  }
+  else
+  {
+    values[index.first->second].second = value;
+  }
+}
+
+void ParameterEdit::setFollow(const int slice, const int target, const float value)
+{
+  follow.push_back({slice, target, value});
+}
+
+void ParameterEdit::clearFollow(const int slice)
+{
+  follow.push_back({slice, -1, 0.f});
+}
+
+void ParameterEdit::setWarp(const int slice, const int warpIndex, const float value)
+{
+  warp.push_back({slice, warpIndex, value});
+}
+
+void ParameterEdit::setContextFollow(const uint64 c, const int target, const float value)
+{
+  context.push_back({c, target, value});
+}
+
+void ParameterEdit::clearContext(const uint64 c)
+{
+  context.push_back({c, -1, 0.f});
+}
+
+bool ParameterEdit::isEmpty() const
+{
+  return values.empty() && follow.empty() && warp.empty() && context.empty();
+}
+
+void ParameterEdit::beginGesture()
+{
+  isGesture = true;
+}
+
+ParameterValues::ParameterValues()
+  : numSlices(nullptr)
+  , sliceDur(nullptr)
+  , fade(nullptr)
+  , quality(nullptr)
+  , order(nullptr)
+  , slicing(nullptr)
+  , snap(nullptr)
+  , seed(nullptr)
+  , manySlices(nullptr)
+{
+}
+
+void ParameterValues::resolve(AudioProcessorValueTreeState& parameters)
+{
+  numSlices = parameters.getRawParameterValue("numSlices");
+  sliceDur = parameters.getRawParameterValue("sliceDur");
+  fade = parameters.getRawParameterValue("fade");
+  quality = parameters.getRawParameterValue("quality");
+  order = parameters.getRawParameterValue("order");
+  slicing = parameters.getRawParameterValue("slicing");
+  snap = parameters.getRawParameterValue("snap");
+  seed = parameters.getRawParameterValue("seed");
+  manySlices = parameters.getRawParameterValue("manySlices");
+}
+
+ParameterSnapshot ParameterValues::snapshot() const
+{
+  const std::size_t sliceDurIndex =
+    static_cast<std::size_t>(jlimit(0, static_cast<int>(sliceDurs().size()) - 1,
+                                    static_cast<int>(*sliceDur)));
+  const int interpolation = jlimit(0, numInterpolations - 1, static_cast<int>(*quality));
+  return {sliceDurs()[sliceDurIndex], static_cast<Interpolation>(interpolation)};
+}
+
+SamplingTables::SamplingTables()
+  : order(1)
+{
+}
+
 Processor::Processor()
 #ifndef JucePlugin_PreferredChannelConfigurations
   : AudioProcessor(BusesProperties()
@@ -100,26 +363,28 @@ Processor::Processor()
                      )
 #endif
   , mParameters(*this, nullptr)
-  , pState{}
-  , mWarps{{[](const double x) { return x; }, [](const double x) { return 1 - x; },
-            [](const double x) { return x * x * x; },
-            [](const double x) { return 1 - (x * x * x); },
-            [](const double x) { return sin(x * M_PI); },
-            [](const double x) { return 1 - sin(x * M_PI); },
-            [](const double x) { return x + (x * sin(x * 2 * M_PI)); },
-            [](const double x) { return x < 0.5 ? 2 * x : 2 - (2 * x); },
-            [](const double x) { return 1 - (x < 0.5 ? 2 * x : 2 - (2 * x)); },
-            [](const double x) { return fmod(x * 2., 1); },
-            [](const double x) { return 1 - fmod(x * 2., 1); },
-            [](const double x) { return fmod(x * 3., 1); },
-            [](const double x) { return 1 - fmod(x * 3., 1); },
-            [](const double x) { return fmod(x * 4., 1); },
-            [](const double x) { return 1 - fmod(x * 4., 1); },
-            [](const double) { return 0; }}}
+  , randomGenerator(0)
+  , mSamplePosition(0)
+  , mReseed(false)
+  , mHostWasPlaying(false)
+  , mReplayGeneration(0)
+  , mReplayedGeneration(0)
+  , mReplaying(nullptr)
+  , mReplayIndex(0)
+  , mSamplingTablesDirty(false)
+  , mChain(maxNumSlices)
+  , mSlicesDirty(false)
+  , mEmbedAudio(true)
+  , mNumStartedVoices(0)
+  , mCurrentSliceIndex(0)
+  , mRenderKernels{{renderKernel(Interpolation::linear),
+                     renderKernel(Interpolation::hermite),
+                     renderKernel(Interpolation::sinc)}}
+  , mRenderKernel(mRenderKernels[0])
 {
   mParameters.createAndAddParameter(
     "numSlices", "Num Slices", "",
-    NormalisableRange<float>(1.f, static_cast<float>(maxNumSlices)), 8.f,
+    NormalisableRange<float>(1.f, static_cast<float>(numParameterSlices), 1.f), 8.f,
     [](float x) { return String{static_cast<int>(x)}; }, nullptr);
   mParameters.createAndAddParameter(
     "sliceDur", "Beats per Slice", "", NormalisableRange<float>(0.f, 6.f), 2.f,
@@ -128,22 +393,49 @@ Processor::Processor()
     "fade", "Fade", "",
     NormalisableRange<float>(0.f, static_cast<float>(100.f), 0.f, 0.5f), 1.f,
     [](float x) { return String{x}; }, nullptr);
-
-  for (int i = 0; i < maxNumSlices; ++i)
+  mParameters.createAndAddParameter(
+    "quality", "Quality", "",
+    NormalisableRange<float>(0.f, static_cast<float>(numInterpolations - 1), 1.f), 0.f,
+    [](float x) { return interpolationNames()[static_cast<int>(x)]; }, nullptr);
+  mParameters.createAndAddParameter(
+    "order", "Markov Order", "",
+    NormalisableRange<float>(1.f, static_cast<float>(maxMarkovOrder), 1.f), 1.f,
+    [](float x) { return String{static_cast<int>(x)}; }, nullptr);
+  mParameters.createAndAddParameter(
+    "slicing", "Slicing", "", NormalisableRange<float>(0.f, 1.f, 1.f), 0.f,
+    [](float x) { return slicingNames()[static_cast<int>(x)]; }, nullptr);
+  mParameters.createAndAddParameter(
+    "snap", "Slice Edges", "", NormalisableRange<float>(0.f, 1.f, 1.f), 0.f,
+    [](float x) { return edgeNames()[static_cast<int>(x)]; }, nullptr);
+  mParameters.createAndAddParameter(
+    "seed", "Seed", "", NormalisableRange<float>(0.f, static_cast<float>(maxSeed), 1.f),
+    0.f, [](float x) { return String{static_cast<int>(x)}; }, nullptr);
+  mParameters.createAndAddParameter(
+    "manySlices", "Num Slices Beyond 32", "",
+    NormalisableRange<float>(static_cast<float>(numParameterSlices),
+                             static_cast<float>(maxNumSlices), 1.f),
+    static_cast<float>(numParameterSlices),
+    [](float x) {
+      return x > numParameterSlices ? String{static_cast<int>(x)} : String{"off"};
+    },
+    nullptr);
+
+  for (int i = 0; i < numParameterSlices; ++i)
   {
-    for (int j = 0; j < maxNumSlices; ++j)
+    for (int j = 0; j < numParameterSlices; ++j)
     {
       const String parameterID = followProbId(i, j);
       mParameters.createAndAddParameter(
         parameterID, "Follow " + String(i + 1) + " -> " + String(j + 1), "",
         NormalisableRange<float>(0.f, 100.f), 10.f, [](float x) { return String{x}; },
         nullptr);
-      pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] =
-        mParameters.getParameter(parameterID);
+      AudioProcessorParameter* parameter = mParameters.getParameter(parameterID);
+      pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] = parameter;
+      mFollowMatrix.set(i, j, parameter->getValue());
     }
   }
 
-  for (int i = 0; i < maxNumSlices; ++i)
+  for (int i = 0; i < numParameterSlices; ++i)
   {
     for (int j = 0; j < numWarps; ++j)
     {
@@ -152,17 +444,47 @@ Processor::Processor()
         parameterID, "Warp " + String(i + 1) + " - " + String(j + 1), "",
         NormalisableRange<float>(0.f, 100.f), j == 0 ? 100.f : 0.f,
         [](float x) { return String{x}; }, nullptr);
-      pWarpProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] =
-        mParameters.getParameter(parameterID);
+      AudioProcessorParameter* parameter = mParameters.getParameter(parameterID);
+      pWarpProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] = parameter;
+      mWarpMatrix.set(i, j, parameter->getValue());
     }
   }
 
+  mValues.resolve(mParameters);
+
   mParameters.addParameterListener("numSlices", this);
+  mParameters.addParameterListener("sliceDur", this);
   mParameters.addParameterListener("fade", this);
+  mParameters.addParameterListener("quality", this);
+  mParameters.addParameterListener("order", this);
+  mParameters.addParameterListener("slicing", this);
+  mParameters.addParameterListener("snap", this);
+  mParameters.addParameterListener("seed", this);
+  mParameters.addParameterListener("manySlices", this);
+
+  for (int i = 0; i < numParameterSlices; ++i)
+  {
+    for (int j = 0; j < numParameterSlices; ++j)
+    {
+      mParameters.addParameterListener(followProbId(i, j), this);
+    }
+  }
+
+  for (int i = 0; i < numParameterSlices; ++i)
+  {
+    for (int j = 0; j < numWarps; ++j)
+    {
+      mParameters.addParameterListener(warpProbId(i, j), this);
+    }
+  }
+
+  rebuildSamplingTables();
+  startTimer(20);
 }
 
 Processor::~Processor()
 {
+  stopTimer();
 }
 
 const String Processor::getName() const
@@ -216,8 +538,15 @@ void Processor::changeProgramName(int, const String&)
 {
 }
 
-void Processor::prepareToPlay(double, int)
+void Processor::prepareToPlay(double sampleRate, int)
 {
+  mLoader.setSampleRate(sampleRate);
+  // playback starts over without the notes held before
+  mVoices.fill(Voice());
+  mNumStartedVoices = 0;
+  mReseed = false;
+  mHostWasPlaying = false;
+  restartPath();
 }
 
 void Processor::releaseResources()
@@ -245,7 +574,19 @@ bool Processor::isBusesLayoutSupported(const BusesLayout& layouts) const
 }
 #endif
 
+// every block is timed against how long the audio it renders lasts
 void Processor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiBuffer)
+{
+  const auto begin = std::chrono::steady_clock::now();
+  renderBlock(buffer, midiBuffer);
+  const auto end = std::chrono::steady_clock::now();
+
+  const double sampleRate = getSampleRate();
+  mBlockStats.addBlock(std::chrono::duration<double>(end - begin).count(),
+                       sampleRate > 0 ? buffer.getNumSamples() / sampleRate : 0);
+}
+
+void Processor::renderBlock(AudioSampleBuffer& buffer, MidiBuffer& midiBuffer)
 {
   const int totalNumInputChannels = getTotalNumInputChannels();
   const int totalNumOutputChannels = getTotalNumOutputChannels();
@@ -253,7 +594,20 @@ void Processor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiBuffer)
   for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
     buffer.clear(i, 0, buffer.getNumSamples());
 
-  StatePtr state = pState;
+  // while playing, a new state is only picked up at the next slice boundary
+  const State* state = mState.pinned();
+  SampleSource::ScopedAccess access(state ? state->source.get() : nullptr);
+  SampleSource::ScopedAccess keptAccess(nullptr);
+  if (!state || !isPlaying())
+  {
+    mState.keep(nullptr);
+    state = pinState(access);
+  }
+  else
+  {
+    keptAccess.reset(getKeptSource(*state));
+  }
+  const SamplingTables& tables = mSamplingTables.read();
 
   AudioPlayHead* playHead = AudioProcessor::getPlayHead();
   AudioPlayHead::CurrentPositionInfo positionInfo;
@@ -263,285 +617,1228 @@ void Processor::processBlock(AudioSampleBuffer& buffer, MidiBuffer& midiBuffer)
     return;
   }
 
-  const double sliceDuration = getSliceDuration();
+  // a take starts over with the seed whenever the transport starts
+  if (mReseed.exchange(false) || (positionInfo.isPlaying && !mHostWasPlaying))
+  {
+    restartPath();
+  }
+  mHostWasPlaying = positionInfo.isPlaying;
+
+  // the generation is counted after the path is published, so that it is read first
+  const uint32 replayGeneration = mReplayGeneration.load(std::memory_order_acquire);
+  mReplaying = mReplay.pin();
+  if (replayGeneration != mReplayedGeneration)
+  {
+    mReplayedGeneration = replayGeneration;
+    mReplayIndex = 0;
+  }
+
+  const ParameterSnapshot parameters = mValues.snapshot();
   const double hostProgress =
-    fmod(positionInfo.ppqPosition, sliceDuration) / sliceDuration;
+    fmod(positionInfo.ppqPosition, parameters.sliceDuration) / parameters.sliceDuration;
+  const double beatsPerSample = (positionInfo.bpm / 60.) / getSampleRate();
+  mRenderKernel = mRenderKernels[static_cast<std::size_t>(parameters.interpolation)];
+
+  Block block{state,
+              access,
+              keptAccess,
+              tables,
+              buffer.getArrayOfWritePointers(),
+              totalNumOutputChannels,
+              buffer.getNumSamples(),
+              beatsPerSample / parameters.sliceDuration,
+              hostProgress,
+              positionInfo.isPlaying};
 
-  processMidiMessages(state, midiBuffer, state->isPlaying() ? hostProgress : 0);
+  int time;
+  MidiMessage message;
+  MidiBuffer::Iterator events(midiBuffer);
+  bool hasEvent = events.getNextEvent(message, time);
 
-  if (state->isPlaying())
+  // the block is split at events, so that each takes effect on its own sample
+  for (int start = 0; start < block.numSamples;)
   {
-    const double beatsPerSample = (positionInfo.bpm / 60.) / getSampleRate();
-    const double slicePerSample = beatsPerSample / sliceDuration;
-    double driftCompesation =
-      positionInfo.isPlaying ? (1 - state->currentSliceProgress) / (1 - hostProgress) : 1;
-    driftCompesation = driftCompesation < 0.5 ? driftCompesation + 1 : driftCompesation;
+    for (; hasEvent && time <= start; hasEvent = events.getNextEvent(message, time))
+    {
+      processMidiMessage(block, message, start);
+    }
 
-    AudioBuffer<float>& sliceBuffer =
-      state->slices[static_cast<std::size_t>(state->currentSliceIndex)];
+    const int end = hasEvent ? std::min(time, block.numSamples) : block.numSamples;
+    renderVoices(block, start, end);
+    start = end;
+  }
 
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
-    {
-      const double warpedProgress =
-        mWarps[static_cast<std::size_t>(state->currentWarpIndex)](
-          state->currentSliceProgress);
-      const double index = warpedProgress * (sliceBuffer.getNumSamples() - 1);
-      const float x = fmodf(static_cast<float>(index), 1);
-      const int loIndex = static_cast<int>(floor(index));
-      const int hiIndex =
-        std::min(static_cast<int>(ceil(index)), sliceBuffer.getNumSamples() - 1);
+  mSamplePosition += block.numSamples;
+}
 
-      if (state->currentWarpIndex < numWarps - 1)
-      {
-        for (int channel = 0; channel < totalNumOutputChannels; ++channel)
-        {
-          const int bufChannel = channel & buffer.getNumChannels();
-          const float a = sliceBuffer.getSample(bufChannel, loIndex);
-          const float b = sliceBuffer.getSample(bufChannel, hiIndex);
-          const float sample = a + x * (b - a);
-          buffer.setSample(channel, i, sample);
-        }
-      }
+double Processor::Block::hostProgressAt(const int sample) const
+{
+  const double progress = hostProgress + (hostIsPlaying ? sample * slicePerSample : 0);
+  return progress - floor(progress);
+}
 
-      state->currentSliceProgress += slicePerSample * driftCompesation;
+void Processor::renderVoices(Block& block, const int start, const int end)
+{
+  Voice* lead = getLeadVoice();
+  if (!lead)
+  {
+    return;
+  }
 
-      if (state->currentSliceProgress >= 1.)
-      {
-        driftCompesation = 1.;
-        startNextSlice(state);
-      }
+  // the lead voice goes first, it decides when a new state is pinned, the others move on
+  // to it at their own slice boundaries
+  renderVoice(*lead, block, start, end, true);
+  for (Voice& voice : mVoices)
+  {
+    if (&voice != lead && voice.isActive())
+    {
+      renderVoice(voice, block, start, end, false);
     }
   }
+
+  mCurrentSliceIndex = lead->sliceIndex;
 }
 
-void Processor::openFile(const File& file)
+// Renders samples start to end for one voice, split into runs that end at slice
+// boundaries and gain ramps.
+void Processor::renderVoice(
+  Voice& voice, Block& block, const int start, const int end, const bool isLead)
 {
-  AudioFormatManager formatManager;
-  formatManager.registerBasicFormats();
+  if (voice.sliceIndex >= voice.state->numSlices)
+  {
+    voice.sliceIndex = voice.sliceIndex % voice.state->numSlices;
+  }
+
+  double driftCompesation =
+    block.hostIsPlaying ? (1 - voice.sliceProgress) / (1 - block.hostProgressAt(start))
+                        : 1;
+  driftCompesation = driftCompesation < 0.5 ? driftCompesation + 1 : driftCompesation;
 
-  ScopedPointer<AudioFormatReader> reader(formatManager.createReaderFor(file));
+  double increment = block.slicePerSample * driftCompesation;
+  std::array<double, maxRunLength> positions;
 
-  if (reader)
+  if (voice.state->source->isStreaming())
   {
-    AudioBuffer<float> buffer(static_cast<int>(reader->numChannels),
-                              static_cast<int>(reader->lengthInSamples));
-    reader->read(&buffer, 0, static_cast<int>(reader->lengthInSamples), 0, true, true);
-    pState = std::make_shared<State>(buffer, reader->sampleRate, getNumSlices(),
-                                     getFadeDuration());
-    mStateChanged.set();
+    prefetch(*voice.state, voice, increment);
   }
-}
 
-int Processor::getNumSlices() const
-{
-  return static_cast<int>(*mParameters.getRawParameterValue("numSlices"));
-}
+  for (int i = start; i < end && voice.isActive();)
+  {
+    const int numSamples = std::min(end - i, maxRunLength);
+    const double untilNextSlice =
+      increment > 0 ? ceil((1. - voice.sliceProgress) / increment) : numSamples;
+    const float gainChange = voice.getTargetGain() - voice.gain;
+    const int untilRampEnd =
+      gainChange != 0 ? static_cast<int>(ceil(std::abs(gainChange) * voiceRampLength))
+                      : numSamples;
+    const int runLength = static_cast<int>(jlimit(
+      1., static_cast<double>(std::min(numSamples, untilRampEnd)), untilNextSlice));
+    const float gainIncrement = gainChange / untilRampEnd;
+
+    const State& state = *voice.state;
+    const Slice& slice = state.slices[static_cast<std::size_t>(voice.sliceIndex)];
+
+    if (voice.warpIndex != silentWarp)
+    {
+      warpKernels()[static_cast<std::size_t>(voice.warpIndex)](
+        voice.sliceProgress, increment, slice.length - 1, runLength, positions.data());
+      renderRun(state, slice, positions.data(), runLength,
+                {block.channels, block.numChannels, i, voice.gain, gainIncrement});
+    }
 
-double Processor::getFadeDuration() const
-{
-  return static_cast<double>(*mParameters.getRawParameterValue("fade"));
-}
+    voice.sliceProgress += runLength * increment;
+    voice.gain = runLength == untilRampEnd ? voice.getTargetGain()
+                                           : voice.gain + runLength * gainIncrement;
+    i += runLength;
 
-int Processor::getSliceDurationIndex() const
-{
-  return static_cast<int>(*mParameters.getRawParameterValue("sliceDur"));
+    if (voice.gain == 0 && voice.pendingNote != -1)
+    {
+      increment = block.slicePerSample;
+      startNote(voice, block, voice.pendingNote, block.hostProgressAt(i), i);
+    }
+    else if (voice.sliceProgress >= 1.)
+    {
+      increment = block.slicePerSample;
+      if (isLead && haveOthersCaughtUp(voice, block.state))
+      {
+        moveOnToLatestState(block);
+      }
+      voice.state = block.state;
+      startNextSlice(voice, block.tables, block.state->numSlices, i);
+    }
+  }
 }
 
-double Processor::getSliceDuration() const
+// whether all voices but the lead play from the state pinned, so that none needs the
+// one kept before it any longer
+bool Processor::haveOthersCaughtUp(const Voice& lead, const State* state) const
 {
-  return sliceDurs()[static_cast<std::size_t>(getSliceDurationIndex())];
+  return std::none_of(mVoices.begin(), mVoices.end(), [&](const Voice& voice) {
+    return &voice != &lead && voice.isActive() && voice.state != state;
+  });
 }
 
-bool Processor::hasEditor() const
+// The state pinned so far is kept for the voices still in a slice of it, their access
+// to its source goes on until they have all moved on as well.
+void Processor::moveOnToLatestState(Block& block)
 {
-  return true;
+  block.keptAccess.reset(nullptr);
+  mState.keep(block.state);
+  block.state = pinState(block.access);
+  block.keptAccess.reset(getKeptSource(*block.state));
 }
 
-AudioProcessorEditor* Processor::createEditor()
+// the source of the kept state, unless the pinned one reads the same
+SampleSource* Processor::getKeptSource(const State& state) const
 {
-  return new Editor(*this);
+  const State* kept = mState.kept();
+  return kept && kept->source != state.source ? kept->source.get() : nullptr;
 }
 
-void Processor::getStateInformation(MemoryBlock& destData)
+// Moves on to the latest state. The source of the previous one may be destroyed as
+// soon as it is unpinned, so the access to it ends first.
+const State* Processor::pinState(SampleSource::ScopedAccess& access)
 {
-  MemoryOutputStream stream(destData, true);
-
-  stream.writeFloat(*mParameters.getRawParameterValue("numSlices"));
-  stream.writeFloat(*mParameters.getRawParameterValue("sliceDur"));
-  stream.writeFloat(*mParameters.getRawParameterValue("fade"));
-
-  for (int i = 0; i < maxNumSlices; ++i)
+  access.reset(nullptr);
+  const State* previous = mState.pinned();
+  const State* state = mState.pin();
+  access.reset(state ? state->source.get() : nullptr);
+  if (state != previous)
   {
-    for (int j = 0; j < maxNumSlices; ++j)
-    {
-      stream.writeFloat(
-        pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]
-          ->getValue());
-    }
+    mBlockStats.addStateSwap();
   }
+  return state;
+}
+
+// Renders positions of one slice from wherever the source holds them. Streamed audio
+// that spans more than one page is split up, audio that isn't loaded yet stays silent.
+void Processor::renderRun(const State& state,
+                          const Slice& slice,
+                          const double* positions,
+                          const int numSamples,
+                          const RenderTarget& target)
+{
+  SampleSource& source = *state.source;
+  int64 first = slice.offset;
+  int64 last = slice.offset + slice.length - 1;
 
-  for (int i = 0; i < maxNumSlices; ++i)
+  if (source.isStreaming())
   {
-    for (int j = 0; j < numWarps; ++j)
-    {
-      stream.writeFloat(
-        pWarpProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]->getValue());
-    }
+    // the frames around the positions that the interpolation reads as well
+    const auto range = std::minmax_element(positions, positions + numSamples);
+    const int64 lastFrame = slice.length - 1;
+    first += jlimit<int64>(
+      0, lastFrame, static_cast<int64>(*range.first) - (interpolationReach - 1));
+    last = slice.offset
+           + jlimit<int64>(
+             0, lastFrame, static_cast<int64>(*range.second) + interpolationReach);
   }
 
-  StatePtr state = pState;
-  if (state)
+  SampleSource::Span span;
+  if (source.getSpan(first, last, span))
   {
-    stream.writeInt(state->buffer.getNumChannels());
-    stream.writeInt(state->buffer.getNumSamples());
-    const float** data = state->buffer.getArrayOfReadPointers();
-    for (int i = 0; i < state->buffer.getNumChannels(); ++i)
-    {
-      stream.writeDouble(state->sampleRate);
-      stream.write(data[static_cast<std::size_t>(i)],
-                   static_cast<std::size_t>(state->buffer.getNumSamples())
-                     * sizeof(float));
-    }
+    // within a page of the frames read, the clamp only guards the narrowing
+    const int64 offset = slice.offset - span.first;
+    mRenderKernel({span.channels, source.getNumChannels(),
+                   static_cast<int>(jlimit<int64>(INT_MIN, INT_MAX, offset)),
+                   slice.length - 1, state.fadeSamples},
+                  positions, numSamples, target);
   }
-  else
+  else if (numSamples > 1)
   {
-    stream.writeInt(0);
+    const int half = numSamples / 2;
+    renderRun(state, slice, positions, half, target);
+    renderRun(state, slice, positions + half, numSamples - half,
+              {target.channels, target.numChannels, target.offset + half,
+               target.gain + half * target.gainIncrement, target.gainIncrement});
   }
 }
 
-void Processor::setStateInformation(const void* data, int sizeInBytes)
+// Requests the audio the current slice of a voice and its already drawn next one will
+// read soon.
+void Processor::prefetch(const State& state, const Voice& voice, const double increment)
 {
-  MemoryInputStream stream(data, static_cast<std::size_t>(sizeInBytes), false);
-
-  *mParameters.getRawParameterValue("numSlices") = stream.readFloat();
-  *mParameters.getRawParameterValue("sliceDur") = stream.readFloat();
-  *mParameters.getRawParameterValue("fade") = stream.readFloat();
-
-  for (int i = 0; i < maxNumSlices; ++i)
-  {
-    for (int j = 0; j < maxNumSlices; ++j)
-    {
-      pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]->setValue(
-        stream.readFloat());
-    }
-  }
+  const double step = increment * prefetchStep;
+  double progress = voice.sliceProgress;
+  int sliceIndex = voice.sliceIndex;
+  int warpIndex = voice.warpIndex;
+  bool isNextSlice = false;
 
-  for (int i = 0; i < maxNumSlices; ++i)
+  for (int i = 0; i < numPrefetchSteps; ++i)
   {
-    for (int j = 0; j < numWarps; ++j)
+    if (progress >= 1.)
     {
-      pWarpProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]->setValue(
-        stream.readFloat());
+      if (isNextSlice)
+      {
+        return;
+      }
+      isNextSlice = true;
+      progress -= 1.;
+      sliceIndex = voice.nextSliceIndex % state.numSlices;
+      warpIndex = voice.nextWarpIndex;
     }
-  }
 
-  const int numChannels = stream.readInt();
-  if (numChannels > 0)
-  {
-    const int numSamples = stream.readInt();
-    const double sampleRate = stream.readDouble();
-    AudioBuffer<float> buffer(numChannels, numSamples);
-    for (int i = 0; i < numChannels; ++i)
+    // the silent warp reads nothing
+    if (warpIndex != silentWarp)
     {
-      stream.read(buffer.getWritePointer(i),
-                  numSamples * static_cast<int>(sizeof(float)));
+      const Slice& slice = state.slices[static_cast<std::size_t>(sliceIndex)];
+      const double position =
+        warps()[static_cast<std::size_t>(warpIndex)](progress) * (slice.length - 1);
+      state.source->prefetch(slice.offset + static_cast<int64>(position));
     }
-    pState =
-      std::make_shared<State>(buffer, sampleRate, getNumSlices(), getFadeDuration());
+    progress += step;
   }
 }
 
-void Processor::parameterChanged(const String& parameterID, float)
+bool Processor::openFile(const File& file)
 {
-  const int numSlices = getNumSlices();
-  const double fade = getFadeDuration();
-
-  StatePtr currentState = pState;
+  std::shared_ptr<SampleSource> original = openSampleSource(file);
 
-  if (currentState
-      && (static_cast<int>(currentState->slices.size()) != numSlices
-          || parameterID == "fade"))
+  if (!original)
   {
-    StatePtr state = std::make_shared<State>(*currentState);
-    state->makeSlices(numSlices, fade);
-    pState = state;
+    return false;
   }
+
+  std::shared_ptr<SampleSource> source = convertSampleRate(original, getSampleRate());
+  std::shared_ptr<const Onsets> onsets = detectOnsets(*source);
+  std::shared_ptr<const ZeroCrossings> zeroCrossings = findZeroCrossings(*source);
+  mLoader.adopt(original, source);
+  publishSource(std::move(original), std::move(source), std::move(onsets),
+                std::move(zeroCrossings));
+  return true;
 }
 
-void Processor::startNextSlice(StatePtr state)
+void Processor::loadFile(const File& file)
 {
-  const int numSlices = getNumSlices();
-  const int slice = state->currentSliceIndex;
-  const int nextSlice = getNextSlice(slice, numSlices);
-  const int nextWarp = getWarp(nextSlice);
-  startSlice(state, nextSlice, nextWarp, 0);
+  mLoader.load(file);
 }
 
-void Processor::startSlice(StatePtr state,
-                           const int slice,
-                           const int warp,
-                           const double hostProgress)
+void Processor::setEmbedAudio(const bool embed)
 {
-  state->currentSliceIndex = slice;
-  state->currentSliceProgress = hostProgress;
-  state->currentWarpIndex = warp;
-  mStateChanged.set();
+  mEmbedAudio = embed;
 }
 
-void Processor::processMidiMessages(StatePtr state,
-                                    MidiBuffer& midiBuffer,
-                                    const double hostProgress)
+bool Processor::getEmbedAudio() const
 {
-  int time;
-  MidiMessage m;
-  const int numSlices = getNumSlices();
-
-  for (MidiBuffer::Iterator i(midiBuffer); i.getNextEvent(m, time);)
-  {
-    const int note = m.getNoteNumber();
+  return mEmbedAudio;
+}
 
-    if (m.isNoteOn() && !state->isPlaying())
+void Processor::cancelLoading()
+{
+  mLoader.cancel();
+}
+
+bool Processor::isLoading() const
+{
+  return mLoader.isLoading();
+}
+
+double Processor::getLoadingProgress() const
+{
+  return mLoader.getProgress();
+}
+
+int Processor::getNumSlices() const
+{
+  const int manySlices = static_cast<int>(*mValues.manySlices);
+  return manySlices > numParameterSlices ? manySlices
+                                         : static_cast<int>(*mValues.numSlices);
+}
+
+void Processor::setNumSlices(const int numSlices)
+{
+  const int count = jlimit(1, maxNumSlices, numSlices);
+  AudioProcessorParameter* many = mParameters.getParameter("manySlices");
+  many->setValueNotifyingHost(mParameters.getParameterRange("manySlices")
+                                .convertTo0to1(static_cast<float>(count)));
+  if (count <= numParameterSlices)
+  {
+    AudioProcessorParameter* parameter = mParameters.getParameter("numSlices");
+    parameter->setValueNotifyingHost(mParameters.getParameterRange("numSlices")
+                                       .convertTo0to1(static_cast<float>(count)));
+  }
+}
+
+double Processor::getFadeDuration() const
+{
+  return static_cast<double>(*mValues.fade);
+}
+
+int Processor::getSliceDurationIndex() const
+{
+  return static_cast<int>(*mValues.sliceDur);
+}
+
+double Processor::getSliceDuration() const
+{
+  return sliceDurs()[static_cast<std::size_t>(getSliceDurationIndex())];
+}
+
+Interpolation Processor::getInterpolation() const
+{
+  return static_cast<Interpolation>(
+    jlimit(0, numInterpolations - 1, static_cast<int>(*mValues.quality)));
+}
+
+int Processor::getMarkovOrder() const
+{
+  return jlimit(1, maxMarkovOrder, static_cast<int>(*mValues.order));
+}
+
+Slicing Processor::getSlicing() const
+{
+  return *mValues.slicing >= 0.5f ? Slicing::onsets : Slicing::equal;
+}
+
+bool Processor::getSnapEdges() const
+{
+  return *mValues.snap >= 0.5f;
+}
+
+int Processor::getSeed() const
+{
+  return static_cast<int>(*mValues.seed);
+}
+
+MarkovPath Processor::getRecordedPath() const
+{
+  return mRecorder.recorded();
+}
+
+void Processor::replayPath(std::shared_ptr<const MarkovPath> path)
+{
+  mReplay.publish(std::move(path));
+  mReplayGeneration.fetch_add(1, std::memory_order_release);
+}
+
+bool Processor::isReplaying() const
+{
+  return mReplay.get() != nullptr;
+}
+
+BlockStatsSnapshot Processor::getBlockStats() const
+{
+  return mBlockStats.snapshot();
+}
+
+void Processor::resetBlockStats()
+{
+  mBlockStats.reset();
+}
+
+int Processor::getCurrentSliceIndex() const
+{
+  return mCurrentSliceIndex;
+}
+
+StatePtr Processor::getState() const
+{
+  return mState.get();
+}
+
+float Processor::getChainFollow(const int slice, const int target) const
+{
+  std::lock_guard<std::mutex> lock(mChainMutex);
+  return mChain.getFollow(slice, target);
+}
+
+float Processor::getChainWarp(const int slice, const int warp) const
+{
+  std::lock_guard<std::mutex> lock(mChainMutex);
+  return mChain.getWarp(slice, warp);
+}
+
+std::vector<SparseChain::Transition> Processor::getChainFollowRow(const int slice) const
+{
+  std::lock_guard<std::mutex> lock(mChainMutex);
+  return mChain.getFollowRow(slice);
+}
+
+bool Processor::hasContextRow(const uint64 context) const
+{
+  std::lock_guard<std::mutex> lock(mChainMutex);
+  return mContexts.getRow(context) != nullptr;
+}
+
+float Processor::getContextFollow(uint64 context, const int target) const
+{
+  std::lock_guard<std::mutex> lock(mChainMutex);
+  for (; contextLength(context) > 1; context = contextSuffix(context))
+  {
+    if (const ContextChain::Row* row = mContexts.getRow(context))
+    {
+      auto it = std::find_if(
+        row->begin(), row->end(),
+        [target](const SparseChain::Transition& t) { return t.target == target; });
+      return it != row->end() ? it->value : 0.f;
+    }
+  }
+
+  // the slices shown may lag behind a change to the number of slices
+  const int slice = contextSlice(context);
+  if (usesSparseChain(getNumSlices()) || !isPositiveAndBelow(slice, numParameterSlices)
+      || !isPositiveAndBelow(target, numParameterSlices))
+  {
+    return mChain.getFollow(slice, target);
+  }
+  return mFollowMatrix.value(slice, target);
+}
+
+void Processor::endGesture(ParameterEdit& edit)
+{
+  for (AudioProcessorParameter* parameter : edit.gestures)
+  {
+    parameter->endChangeGesture();
+  }
+  edit.gestures.clear();
+  edit.isGesture = false;
+}
+
+void Processor::applyEdit(ParameterEdit& edit)
+{
+  auto unchanged = std::remove_if(
+    edit.values.begin(), edit.values.end(),
+    [](const std::pair<AudioProcessorParameter*, float>& v) {
+      return v.first->getValue() == jlimit(0.f, 1.f, v.second);
+    });
+  edit.values.erase(unchanged, edit.values.end());
+
+  for (const auto& v : edit.values)
+  {
+    if (!edit.isGesture || edit.gestures.insert(v.first).second)
+    {
+      v.first->beginChangeGesture();
+    }
+  }
+  for (const auto& v : edit.values)
+  {
+    v.first->setValueNotifyingHost(v.second);
+  }
+  if (!edit.isGesture)
+  {
+    for (const auto& v : edit.values)
     {
-      state->midiNote = note;
-      const int slice = note % numSlices;
-      startSlice(state, slice, getWarp(slice), hostProgress);
-      mStateChanged.set();
+      v.first->endChangeGesture();
     }
-    else if (m.isNoteOff() && state->isPlaying() && note == state->midiNote)
+  }
+
+  if (!edit.follow.empty() || !edit.warp.empty() || !edit.context.empty())
+  {
+    std::lock_guard<std::mutex> lock(mChainMutex);
+    for (const ParameterEdit::ChainValue& v : edit.follow)
     {
-      state->midiNote = -1;
-      mStateChanged.set();
+      if (v.column < 0)
+      {
+        mChain.clearFollow(v.slice);
+      }
+      else
+      {
+        mChain.setFollow(v.slice, v.column, jlimit(0.f, 1.f, v.value));
+      }
     }
+    for (const ParameterEdit::ChainValue& v : edit.warp)
+    {
+      mChain.setWarp(v.slice, v.column, jlimit(0.f, 1.f, v.value));
+    }
+    for (const ParameterEdit::ContextValue& v : edit.context)
+    {
+      if (v.target < 0)
+      {
+        mContexts.clearRow(v.context);
+      }
+      else
+      {
+        mContexts.setFollow(v.context, v.target, jlimit(0.f, 1.f, v.value));
+      }
+    }
+  }
+
+  if (!edit.isEmpty())
+  {
+    mSamplingTablesDirty = false;
+    rebuildSamplingTables();
   }
+  edit.values.clear();
+  edit.valueIndices.clear();
+  edit.follow.clear();
+  edit.warp.clear();
+  edit.context.clear();
 }
 
-int Processor::getNextSlice(const int currentSlice, const int numSlices)
+void Processor::rebuildSamplingTables()
 {
-  std::vector<float> sliceWeights;
+  std::lock_guard<std::mutex> lock(mSamplingTablesMutex);
+
+  SamplingTables& tables = mSamplingTables.back();
+  const int numSlices = jlimit(1, maxNumSlices, getNumSlices());
+  tables.follow.reset(numSlices);
+
+  if (!usesSparseChain(numSlices))
+  {
+    std::array<int, numParameterSlices> columns;
+    std::iota(columns.begin(), columns.end(), 0);
+    for (int i = 0; i < numSlices; ++i)
+    {
+      tables.follow.addRow(columns.data(), mFollowMatrix.weights(i), numSlices,
+                           mFollowMatrix.weightSum(i, numSlices));
+      tables.warp[static_cast<std::size_t>(i)].build(mWarpMatrix.weights(i), numWarps,
+                                                     mWarpMatrix.weightSum(i, numWarps));
+    }
+    std::lock_guard<std::mutex> chainLock(mChainMutex);
+    addContextRows(tables, numSlices);
+    mSamplingTables.publish();
+    return;
+  }
+
+  std::lock_guard<std::mutex> chainLock(mChainMutex);
+  std::vector<int> columns;
+  std::vector<float> weights;
   for (int i = 0; i < numSlices; ++i)
   {
-    const float val =
-      pFollowProps[static_cast<std::size_t>(currentSlice)][static_cast<std::size_t>(i)]
-        ->getValue();
-    sliceWeights.push_back(val * val);
+    columns.clear();
+    weights.clear();
+    for (const SparseChain::Transition& transition : mChain.getFollowRow(i))
+    {
+      if (transition.target < numSlices)
+      {
+        columns.push_back(transition.target);
+        weights.push_back(transition.value * transition.value);
+      }
+    }
+    tables.follow.addRow(columns.data(), weights.data(),
+                         static_cast<int>(columns.size()));
+
+    std::array<float, numWarps> warpWeights;
+    for (int j = 0; j < numWarps; ++j)
+    {
+      const float value = mChain.getWarp(i, j);
+      warpWeights[static_cast<std::size_t>(j)] = value * value;
+    }
+    tables.warp[static_cast<std::size_t>(i)].build(warpWeights.data(), numWarps);
+  }
+
+  addContextRows(tables, numSlices);
+  mSamplingTables.publish();
+}
+
+// the contexts up to the current order with a transition that can happen, the others
+// back off
+void Processor::addContextRows(SamplingTables& tables, const int numSlices)
+{
+  tables.order = getMarkovOrder();
+  tables.contexts.reset(numSlices);
+  if (tables.order < 2)
+  {
+    return;
+  }
+
+  std::vector<int> columns;
+  std::vector<float> weights;
+  for (const auto& entry : mContexts.getRows())
+  {
+    if (contextLength(entry.first) > tables.order)
+    {
+      continue;
+    }
+    columns.clear();
+    weights.clear();
+    for (const SparseChain::Transition& transition : entry.second)
+    {
+      if (transition.target < numSlices)
+      {
+        columns.push_back(transition.target);
+        weights.push_back(transition.value * transition.value);
+      }
+    }
+    if (!columns.empty())
+    {
+      tables.contexts.addRow(entry.first, columns.data(), weights.data(),
+                             static_cast<int>(columns.size()));
+    }
+  }
+}
+
+bool Processor::hasEditor() const
+{
+  return true;
+}
+
+AudioProcessorEditor* Processor::createEditor()
+{
+  return new Editor(*this);
+}
+
+namespace
+{
+// "BRKV". The unversioned layout starts with the numSlices float, which never has this
+// bit pattern.
+const int stateMagic = 0x564b5242;
+const int stateVersion = 2;
+
+// The versioned layout is a header followed by chunks of an id, a size and the data.
+// Readers skip chunks they don't know.
+int chunkId(const char* name)
+{
+  return static_cast<int>(ByteOrder::littleEndianInt(name));
+}
+
+void writeChunk(OutputStream& stream, const char* name, const MemoryOutputStream& chunk)
+{
+  stream.writeInt(chunkId(name));
+  stream.writeInt(static_cast<int>(chunk.getDataSize()));
+  stream.write(chunk.getData(), chunk.getDataSize());
+}
+
+// only the values that differ from the parameter defaults, most of them don't
+template <typename Parameters, typename Matrix>
+void writeChangedValues(OutputStream& stream,
+                        const Parameters& parameters,
+                        const Matrix& matrix)
+{
+  MemoryOutputStream values;
+  int numValues = 0;
+  for (std::size_t i = 0; i < parameters.size(); ++i)
+  {
+    for (std::size_t j = 0; j < parameters[i].size(); ++j)
+    {
+      const float value = matrix.value(static_cast<int>(i), static_cast<int>(j));
+      if (value != parameters[i][j]->getDefaultValue())
+      {
+        values.writeCompressedInt(static_cast<int>(i * parameters[i].size() + j));
+        values.writeFloat(value);
+        ++numValues;
+      }
+    }
+  }
+  stream.writeCompressedInt(numValues);
+  stream.write(values.getData(), values.getDataSize());
+}
+
+template <typename Parameters>
+void readChangedValues(InputStream& stream, Parameters& parameters)
+{
+  for (auto& row : parameters)
+  {
+    for (AudioProcessorParameter* parameter : row)
+    {
+      parameter->setValue(parameter->getDefaultValue());
+    }
+  }
+
+  const std::size_t rowSize = parameters[0].size();
+  const int numValues = stream.readCompressedInt();
+  for (int i = 0; i < numValues && !stream.isExhausted(); ++i)
+  {
+    const std::size_t index = static_cast<std::size_t>(stream.readCompressedInt());
+    const float value = stream.readFloat();
+    if (index < parameters.size() * rowSize)
+    {
+      parameters[index / rowSize][index % rowSize]->setValue(value);
+    }
+  }
+}
+
+} // namespace
+
+void Processor::getStateInformation(MemoryBlock& destData)
+{
+  MemoryOutputStream stream(destData, true);
+  stream.writeInt(stateMagic);
+  stream.writeInt(stateVersion);
+
+  MemoryOutputStream settings;
+  settings.writeFloat(*mParameters.getRawParameterValue("numSlices"));
+  settings.writeFloat(*mParameters.getRawParameterValue("sliceDur"));
+  settings.writeFloat(*mParameters.getRawParameterValue("fade"));
+  settings.writeBool(mEmbedAudio);
+  settings.writeFloat(*mParameters.getRawParameterValue("quality"));
+  settings.writeFloat(*mParameters.getRawParameterValue("order"));
+  settings.writeFloat(*mParameters.getRawParameterValue("slicing"));
+  settings.writeFloat(*mParameters.getRawParameterValue("snap"));
+  settings.writeFloat(*mParameters.getRawParameterValue("seed"));
+  settings.writeFloat(*mParameters.getRawParameterValue("manySlices"));
+  writeChunk(stream, "PARM", settings);
+
+  MemoryOutputStream follow;
+  writeChangedValues(follow, pFollowProps, mFollowMatrix);
+  writeChunk(stream, "FOLW", follow);
+
+  MemoryOutputStream warp;
+  writeChangedValues(warp, pWarpProps, mWarpMatrix);
+  writeChunk(stream, "WARP", warp);
+
+  MemoryOutputStream chain;
+  MemoryOutputStream contexts;
+  {
+    std::lock_guard<std::mutex> lock(mChainMutex);
+    mChain.write(chain);
+    mContexts.write(contexts);
+  }
+  writeChunk(stream, "CHAN", chain);
+  writeChunk(stream, "CTXT", contexts);
+
+  StatePtr state = mState.get();
+  if (!state)
+  {
+    return;
+  }
+
+  const File file = state->original->getFile();
+  if (file != File())
+  {
+    MemoryOutputStream reference;
+    reference.writeString(file.getFullPathName());
+    reference.writeString(state->original->getFileHash());
+    writeChunk(stream, "FILE", reference);
+  }
+
+  // streamed files are too large to embed, audio restored without a file always is
+  const AudioBuffer<float>* buffer = state->original->getBuffer();
+  if (buffer && (mEmbedAudio || file == File()))
+  {
+    MemoryOutputStream audio;
+    audio.writeDouble(state->original->getSampleRate());
+    writeCompressedAudio(audio, *buffer);
+    writeChunk(stream, "AUDI", audio);
+  }
+}
+
+void Processor::setStateInformation(const void* data, int sizeInBytes)
+{
+  MemoryInputStream stream(data, static_cast<std::size_t>(sizeInBytes), false);
+
+  {
+    // states without chain chunks leave the chains at their defaults
+    std::lock_guard<std::mutex> lock(mChainMutex);
+    mChain = SparseChain(maxNumSlices);
+    mContexts = ContextChain();
+  }
+
+  if (stream.readInt() == stateMagic)
+  {
+    // newer versions only add chunks
+    stream.readInt();
+    readState(stream);
+  }
+  else
+  {
+    stream.setPosition(0);
+    readUnversionedState(stream);
+  }
+
+  rebuildSamplingTables();
+}
+
+void Processor::readState(MemoryInputStream& stream)
+{
+  File file;
+  String hash;
+  AudioBuffer<float> buffer;
+  double sampleRate = 0;
+
+  while (stream.getNumBytesRemaining() >= 8)
+  {
+    const int id = stream.readInt();
+    const int size = stream.readInt();
+    if (size < 0 || size > stream.getNumBytesRemaining())
+    {
+      break;
+    }
+    MemoryInputStream chunk(
+      static_cast<const char*>(stream.getData()) + stream.getPosition(),
+      static_cast<std::size_t>(size), false);
+    stream.skipNextBytes(size);
+
+    if (id == chunkId("PARM"))
+    {
+      // states saved before manySlices existed kept every count in numSlices
+      const float numSlices = chunk.readFloat();
+      *mParameters.getRawParameterValue("numSlices") =
+        std::min(numSlices, static_cast<float>(numParameterSlices));
+      *mParameters.getRawParameterValue("sliceDur") = chunk.readFloat();
+      *mParameters.getRawParameterValue("fade") = chunk.readFloat();
+      mEmbedAudio = chunk.readBool();
+      // states saved before the quality parameter existed play linear
+      *mParameters.getRawParameterValue("quality") =
+        jlimit(0.f, static_cast<float>(numInterpolations - 1), chunk.readFloat());
+      // and first order, in equal slices with exact edges
+      *mParameters.getRawParameterValue("order") =
+        chunk.isExhausted() ? 1.f : chunk.readFloat();
+      *mParameters.getRawParameterValue("slicing") = chunk.readFloat();
+      *mParameters.getRawParameterValue("snap") = chunk.readFloat();
+      *mParameters.getRawParameterValue("seed") = chunk.readFloat();
+      *mParameters.getRawParameterValue("manySlices") =
+        chunk.isExhausted() ? std::max(numSlices, static_cast<float>(numParameterSlices))
+                            : chunk.readFloat();
+    }
+    else if (id == chunkId("FOLW"))
+    {
+      readChangedValues(chunk, pFollowProps);
+    }
+    else if (id == chunkId("WARP"))
+    {
+      readChangedValues(chunk, pWarpProps);
+    }
+    else if (id == chunkId("CHAN"))
+    {
+      std::lock_guard<std::mutex> lock(mChainMutex);
+      mChain.read(chunk);
+    }
+    else if (id == chunkId("CTXT"))
+    {
+      std::lock_guard<std::mutex> lock(mChainMutex);
+      mContexts.read(chunk, maxNumSlices);
+    }
+    else if (id == chunkId("FILE"))
+    {
+      file = File(chunk.readString());
+      hash = chunk.readString();
+    }
+    else if (id == chunkId("AUDI"))
+    {
+      sampleRate = chunk.readDouble();
+      if (!readCompressedAudio(chunk, buffer))
+      {
+        buffer.setSize(0, 0);
+      }
+    }
+  }
+
+  if (buffer.getNumSamples() > 0)
+  {
+    auto source = makeMemorySource(std::move(buffer), sampleRate, file);
+    source->setFileHash(hash);
+    // the loader detects the onsets as it converts the source
+    mLoader.adopt(source, nullptr);
+    publishSource(source, source, nullptr, nullptr);
+  }
+  else if (file != File())
+  {
+    mLoader.load(file, hash);
+  }
+}
+
+// The layout written before the state was versioned: all parameters as floats, then
+// the decoded audio with a sample rate before each channel, or the path of a streamed
+// file.
+void Processor::readUnversionedState(MemoryInputStream& stream)
+{
+  *mParameters.getRawParameterValue("numSlices") = stream.readFloat();
+  *mParameters.getRawParameterValue("sliceDur") = stream.readFloat();
+  *mParameters.getRawParameterValue("fade") = stream.readFloat();
+  // the parameters added since play as they did before they existed
+  *mParameters.getRawParameterValue("quality") =
+    static_cast<float>(Interpolation::linear);
+  *mParameters.getRawParameterValue("order") = 1.f;
+  *mParameters.getRawParameterValue("slicing") = static_cast<float>(Slicing::equal);
+  *mParameters.getRawParameterValue("snap") = 0.f;
+  *mParameters.getRawParameterValue("seed") = 0.f;
+  *mParameters.getRawParameterValue("manySlices") =
+    static_cast<float>(numParameterSlices);
+
+  for (int i = 0; i < numParameterSlices; ++i)
+  {
+    for (int j = 0; j < numParameterSlices; ++j)
+    {
+      pFollowProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]->setValue(
+        stream.readFloat());
+    }
+  }
+
+  for (int i = 0; i < numParameterSlices; ++i)
+  {
+    for (int j = 0; j < numWarps; ++j)
+    {
+      pWarpProps[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)]->setValue(
+        stream.readFloat());
+    }
+  }
+
+  const int numChannels = stream.readInt();
+  if (numChannels > 0)
+  {
+    const int numSamples = stream.readInt();
+    double sampleRate = 0;
+    AudioBuffer<float> buffer(numChannels, numSamples);
+    for (int i = 0; i < numChannels; ++i)
+    {
+      sampleRate = stream.readDouble();
+      stream.read(buffer.getWritePointer(i),
+                  numSamples * static_cast<int>(sizeof(float)));
+    }
+    auto source = makeMemorySource(std::move(buffer), sampleRate);
+    mLoader.adopt(source, nullptr);
+    publishSource(source, source, nullptr, nullptr);
+  }
+  else if (!stream.isExhausted())
+  {
+    loadFile(File(stream.readString()));
+  }
+}
+
+void Processor::parameterChanged(const String& parameterID, float)
+{
+  int row, column;
+  if (matrixCell(parameterID, followPrefix, row, column))
+  {
+    mFollowMatrix.set(row, column,
+                      pFollowProps[static_cast<std::size_t>(row)]
+                                  [static_cast<std::size_t>(column)]->getValue());
+  }
+  else if (matrixCell(parameterID, warpPrefix, row, column))
+  {
+    mWarpMatrix.set(row, column,
+                    pWarpProps[static_cast<std::size_t>(row)]
+                              [static_cast<std::size_t>(column)]->getValue());
+  }
+  mParameterChanges.set(parameterID);
+
+  if (parameterID == "seed")
+  {
+    mReseed = true;
+  }
+
+  if (parameterID == "numSlices" || parameterID == "manySlices" || parameterID == "order"
+      || parameterID.startsWith("followProb_") || parameterID.startsWith("warpProb_"))
+  {
+    mSamplingTablesDirty = true;
+  }
+
+  if (parameterID == "numSlices" || parameterID == "manySlices" || parameterID == "fade"
+      || parameterID == "slicing" || parameterID == "snap")
+  {
+    mSlicesDirty = true;
+  }
+}
+
+void Processor::timerCallback()
+{
+  if (mSamplingTablesDirty.exchange(false))
+  {
+    rebuildSamplingTables();
+  }
+
+  if (mSlicesDirty.exchange(false))
+  {
+    rebuildSlices();
+  }
+
+  LoadedSource loaded = mLoader.takeLoaded();
+  if (loaded.original)
+  {
+    publishSource(std::move(loaded.original), std::move(loaded.source),
+                  std::move(loaded.onsets), std::move(loaded.zeroCrossings));
+  }
+}
+
+void Processor::publishSource(std::shared_ptr<SampleSource> original,
+                              std::shared_ptr<SampleSource> source,
+                              std::shared_ptr<const Onsets> onsets,
+                              std::shared_ptr<const ZeroCrossings> zeroCrossings)
+{
+  mState.publish(std::make_shared<State>(
+    std::move(original), std::move(source), std::move(onsets), std::move(zeroCrossings),
+    getNumSlices(), getFadeDuration(), getSlicing(), getSnapEdges()));
+  mStateChanged.set();
+}
+
+void Processor::rebuildSlices()
+{
+  StatePtr currentState = mState.get();
+
+  if (currentState)
+  {
+    std::shared_ptr<State> state = std::make_shared<State>(*currentState);
+    state->makeSlices(getNumSlices(), getFadeDuration(), getSlicing(), getSnapEdges());
+    mState.publish(state);
+    mStateChanged.set();
   }
-  std::discrete_distribution<> sliceDistribution(sliceWeights.begin(),
-                                                 sliceWeights.end());
-  return sliceDistribution(randomGenerator);
 }
 
-int Processor::getWarp(const int slice)
+bool Processor::isPlaying() const
 {
-  std::vector<float> warpWeights;
-  for (int i = 0; i < numWarps; ++i)
+  return std::any_of(mVoices.begin(), mVoices.end(),
+                     [](const Voice& voice) { return voice.isActive(); });
+}
+
+// the active voice that started first
+Voice* Processor::getLeadVoice()
+{
+  Voice* lead = nullptr;
+  for (Voice& voice : mVoices)
   {
-    const float val =
-      pWarpProps[static_cast<std::size_t>(slice)][static_cast<std::size_t>(i)]
-        ->getValue();
-    warpWeights.push_back(val * val);
+    if (voice.isActive() && (!lead || voice.startOrder < lead->startOrder))
+    {
+      lead = &voice;
+    }
   }
-  std::discrete_distribution<> warpDistribution(warpWeights.begin(), warpWeights.end());
-  return warpDistribution(randomGenerator);
+  return lead;
+}
+
+// a voice that is fading out already with no note waiting for it, or else the one that
+// started first
+Voice& Processor::getVoiceToSteal()
+{
+  Voice* steal = &mVoices.front();
+  for (Voice& voice : mVoices)
+  {
+    if (voice.getTargetGain() == 0 && voice.pendingNote == -1)
+    {
+      return voice;
+    }
+    if (voice.startOrder < steal->startOrder)
+    {
+      steal = &voice;
+    }
+  }
+  return *steal;
+}
+
+void Processor::startNote(Voice& voice,
+                          const Block& block,
+                          const int note,
+                          const double hostProgress,
+                          const int sample)
+{
+  const int numSlices = block.state->numSlices;
+  voice.state = block.state;
+  voice.midiNote = note;
+  voice.pendingNote = -1;
+  voice.startOrder = ++mNumStartedVoices;
+  voice.history.fill(-1);
+  const Decision first = decide(block.tables, voice, numSlices, note % numSlices, sample);
+  startSlice(voice, block.tables, numSlices, first.slice, first.warp, hostProgress,
+             sample);
+}
+
+void Processor::startNextSlice(Voice& voice,
+                               const SamplingTables& tables,
+                               const int numSlices,
+                               const int sample)
+{
+  std::copy(voice.history.begin() + 1, voice.history.end(), voice.history.begin());
+  voice.history.back() = voice.sliceIndex;
+  startSlice(voice, tables, numSlices, voice.nextSliceIndex % numSlices,
+             voice.nextWarpIndex, 0, sample);
+}
+
+void Processor::startSlice(Voice& voice,
+                           const SamplingTables& tables,
+                           const int numSlices,
+                           const int slice,
+                           const int warp,
+                           const double hostProgress,
+                           const int sample)
+{
+  voice.sliceIndex = slice;
+  voice.sliceProgress = hostProgress;
+  voice.warpIndex = warp;
+  const Decision next = decide(tables, voice, numSlices, -1, sample);
+  voice.nextSliceIndex = next.slice;
+  voice.nextWarpIndex = next.warp;
+  mBlockStats.addSliceSwitch();
+  mStateChanged.set();
+}
+
+void Processor::processMidiMessage(const Block& block,
+                                   const MidiMessage& message,
+                                   const int sample)
+{
+  const int note = message.getNoteNumber();
+
+  if (message.isNoteOn())
+  {
+    // a note joining others starts in step with the host, a lone one at its beginning
+    const double hostProgress = isPlaying() ? block.hostProgressAt(sample) : 0;
+    auto free = std::find_if(mVoices.begin(), mVoices.end(),
+                             [](const Voice& voice) { return !voice.isActive(); });
+    if (free != mVoices.end())
+    {
+      startNote(*free, block, note, hostProgress, sample);
+    }
+    else
+    {
+      Voice& voice = getVoiceToSteal();
+      voice.pendingNote = note;
+      voice.startOrder = ++mNumStartedVoices;
+    }
+  }
+  else if (message.isNoteOff())
+  {
+    for (Voice& voice : mVoices)
+    {
+      if (voice.midiNote == note)
+      {
+        voice.midiNote = -1;
+      }
+      if (voice.pendingNote == note)
+      {
+        voice.pendingNote = -1;
+      }
+    }
+    mStateChanged.set();
+  }
+}
+
+// The longest context of the last slices that has a row decides, the current slice
+// alone if none has.
+int Processor::getNextSlice(const SamplingTables& tables,
+                            const Voice& voice,
+                            const int numSlices)
+{
+  std::array<int, maxMarkovOrder> context;
+  std::copy(voice.history.begin(), voice.history.end(), context.begin());
+  context.back() = voice.sliceIndex;
+
+  // the tables may still be built for a previous number of slices
+  for (int length = tables.order; length > 1; --length)
+  {
+    const int* first = context.data() + maxMarkovOrder - length;
+    const int row = *first >= 0 ? tables.contexts.find(contextKey(first, length)) : -1;
+    if (row >= 0)
+    {
+      return tables.contexts(row, randomGenerator) % numSlices;
+    }
+  }
+  return tables.follow(voice.sliceIndex, randomGenerator) % numSlices;
+}
+
+int Processor::getWarp(const SamplingTables& tables, const int slice)
+{
+  return tables.warp[static_cast<std::size_t>(slice)](randomGenerator);
+}
+
+// The slice and warp a voice plays next, from the path being replayed while it lasts and
+// drawn from the chains otherwise. A slice given, as that of a note, is kept and only
+// the warp is decided. Decisions are recorded either way.
+Decision Processor::decide(const SamplingTables& tables,
+                           const Voice& voice,
+                           const int numSlices,
+                           const int slice,
+                           const int sample)
+{
+  Decision decision{mSamplePosition + sample, slice, 0};
+  if (mReplaying && mReplayIndex < mReplaying->size())
+  {
+    const Decision& replayed = (*mReplaying)[mReplayIndex++];
+    decision.slice = slice >= 0 ? slice : replayed.slice % numSlices;
+    decision.warp = replayed.warp;
+  }
+  else
+  {
+    decision.slice = slice >= 0 ? slice : getNextSlice(tables, voice, numSlices);
+    decision.warp = getWarp(tables, decision.slice);
+  }
+  mRecorder.record(decision);
+  return decision;
+}
+
+void Processor::restartPath()
+{
+  randomGenerator.seed(static_cast<uint64>(getSeed()));
+  mRecorder.restart();
+  mReplayIndex = 0;
+  mSamplePosition = 0;
 }
 
 } // namespace breakov
@@ -17,9 +17,31 @@
 
 #pragma once
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "AliasTable.h"
+#include "BlockStats.h"
+#include "ContextChain.h"
+#include "ContextTable.h"
+#include "FileLoader.h"
+#include "MarkovPath.h"
+#include "Onsets.h"
+#include "ProbabilityMatrix.h"
+#include "Random.h"
+#include "Rcu.h"
+#include "Render.h"
+#include "SampleSource.h"
+#include "SparseAliasTable.h"
+#include "SparseChain.h"
+#include "TripleBuffer.h"
 #include "Warnings.h"
+#include "Warps.h"
+#include "ZeroCrossings.h"
 #include <array>
-#include <random>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 PUSH_WARNINGS
 
@@ -27,9 +49,30 @@ AudioProcessor* JUCE_CALLTYPE createPluginFilter();
 
 namespace breakov
 {
-const static int maxNumSlices = 32;
+const static int maxNumSlices = 1024;
 
-const static int numWarps = 16;
+// Slices whose follow and warp probabilities are host parameters. Chains with more
+// slices take theirs from the sparse chain, see Processor::getChainFollow().
+const static int numParameterSlices = 32;
+
+static bool usesSparseChain(const int numSlices)
+{
+  return numSlices > numParameterSlices;
+}
+
+static_assert(maxNumSlices < (1 << contextBits), "a context key needs every slice");
+
+// longest span of output samples rendered in one go
+const static int maxRunLength = 256;
+
+// streamed audio is requested every prefetchStep output samples for numPrefetchSteps
+const static int prefetchStep = 1024;
+const static int numPrefetchSteps = 32;
+
+const static int maxNumVoices = 8;
+
+// samples over which a voice fades in, out or over to the note that stole it
+const static int voiceRampLength = 128;
 
 const static std::array<double, 7> sliceDurs()
 {
@@ -41,6 +84,33 @@ static StringArray sliceDurNames()
   return {"4", "2", "1", "1/2", "1/4", "1/8", "1/16"};
 }
 
+static StringArray interpolationNames()
+{
+  return {"linear", "hermite", "sinc"};
+}
+
+// how a source is cut into slices
+enum class Slicing
+{
+  equal,
+  onsets
+};
+
+static StringArray slicingNames()
+{
+  return {"equal", "transients"};
+}
+
+static StringArray edgeNames()
+{
+  return {"exact", "snapped"};
+}
+
+// how far a slice edge may move to a zero crossing, in milliseconds
+const static double snapReach = 5;
+
+const static int maxSeed = 9999;
+
 static String followProbId(const int i, const int j)
 {
   return "followProb_" + String(i) + "_" + String(j);
@@ -51,24 +121,71 @@ static String warpProbId(const int i, const int j)
   return "warpProb_" + String(i) + "_" + String(j);
 }
 
+// A view into State::source.
+struct Slice
+{
+  int64 offset;
+  int length;
+};
+
+// Immutable once published, see Processor::mState. Copies share the sample source, so
+// re-slicing a copy doesn't touch the audio.
 struct State
 {
-  State(AudioBuffer<float> b, double sr, int numSlices, double fade);
+  State(std::shared_ptr<SampleSource> o,
+        std::shared_ptr<SampleSource> s,
+        std::shared_ptr<const Onsets> t,
+        std::shared_ptr<const ZeroCrossings> z,
+        int numSlices,
+        double fade,
+        Slicing slicing,
+        bool snap);
+
+  // Cut at the strongest onsets, sources without them in equal slices. Snapped edges
+  // move to where the source is quiet.
+  void makeSlices(int numSlices, double fade, Slicing slicing, bool snap);
+  void snapSlices();
+
+  // the source as loaded, which is saved and painted
+  std::shared_ptr<SampleSource> original;
+  // the source played, at the host sample rate where possible
+  std::shared_ptr<SampleSource> source;
+  // the onsets and zero crossings of the source played, if they have been found
+  std::shared_ptr<const Onsets> onsets;
+  std::shared_ptr<const ZeroCrossings> zeroCrossings;
+  std::array<Slice, maxNumSlices> slices;
+  int numSlices;
+  double fadeSamples;
+};
 
-  void makeSlices(int numSlices, double fade);
-  bool isPlaying();
+using StatePtr = std::shared_ptr<const State>;
 
-  AudioBuffer<float> buffer;
-  std::vector<AudioBuffer<float>> slices;
-  double sampleRate;
-  double currentSliceProgress;
-  int currentSliceIndex;
-  int currentWarpIndex;
+// A read head with its own position in the Markov chain, owned by the audio thread. The
+// next slice and warp are drawn when a slice starts, so that streamed audio can be
+// requested ahead.
+struct Voice
+{
+  Voice();
+
+  bool isActive() const;
+  float getTargetGain() const;
+
+  // the state the current slice plays from, kept until the voice starts its next one
+  const State* state;
+  double sliceProgress;
+  int sliceIndex;
+  // the slices played before, oldest first, -1 where the note hadn't started yet
+  std::array<int, maxMarkovOrder - 1> history;
+  int warpIndex;
+  int nextSliceIndex;
+  int nextWarpIndex;
   int midiNote;
+  // the note that stole this voice, started once it has faded out
+  int pendingNote;
+  float gain;
+  uint32 startOrder;
 };
 
-using StatePtr = std::shared_ptr<State>;
-
 struct StateChanged
 {
   StateChanged();
@@ -79,15 +196,135 @@ struct StateChanged
   std::atomic_flag mFlag;
 };
 
-using Warp = std::function<double(double)>;
+// Which parameters changed since the editor last looked: one bit per scalar parameter
+// and per row of the follow and warp matrices. Bits are set by whichever thread changes
+// a parameter and taken by the editor timer, neither side waits for the other.
+struct ParameterChanges
+{
+  enum Scalar : uint32
+  {
+    numSlices = 1 << 0,
+    sliceDur = 1 << 1,
+    fade = 1 << 2,
+    quality = 1 << 3,
+    order = 1 << 4,
+    slicing = 1 << 5,
+    snap = 1 << 6,
+    seed = 1 << 7
+  };
+
+  ParameterChanges();
+
+  void set(const String& parameterID);
+  uint32 takeScalars();
+  uint32 takeFollowRows();
+  uint32 takeWarpRows();
+
+  std::atomic<uint32> mScalars;
+  std::atomic<uint32> mFollowRows;
+  std::atomic<uint32> mWarpRows;
+};
+
+static_assert(numParameterSlices <= 32, "a matrix row needs a bit in ParameterChanges");
 
-using FollowProbs =
-  std::array<std::array<AudioProcessorParameter*, maxNumSlices>, maxNumSlices>;
+using FollowProbs = std::array<std::array<AudioProcessorParameter*, numParameterSlices>,
+                               numParameterSlices>;
 
 using WarpProbs =
-  std::array<std::array<AudioProcessorParameter*, numWarps>, maxNumSlices>;
+  std::array<std::array<AudioProcessorParameter*, numWarps>, numParameterSlices>;
+
+using FollowMatrix = ProbabilityMatrix<numParameterSlices, numParameterSlices>;
+using WarpMatrix = ProbabilityMatrix<numParameterSlices, numWarps>;
+
+// The parameters the audio thread reads, copied once per block.
+struct ParameterSnapshot
+{
+  double sliceDuration;
+  Interpolation interpolation;
+};
+
+// The values behind the scalar parameters of the tree state, looked up by id once, so
+// that reading them takes neither a lookup nor a virtual call.
+struct ParameterValues
+{
+  ParameterValues();
+
+  void resolve(AudioProcessorValueTreeState& parameters);
+  ParameterSnapshot snapshot() const;
+
+  const float* numSlices;
+  const float* sliceDur;
+  const float* fade;
+  const float* quality;
+  const float* order;
+  const float* slicing;
+  const float* snap;
+  const float* seed;
+  const float* manySlices;
+};
+
+// New normalised values for any number of parameters and values of the sparse chain,
+// collected on the message thread and handed to Processor::applyEdit in one go.
+struct ParameterEdit
+{
+  // A follow or warp value of the sparse chain. A follow column of -1 clears the row.
+  struct ChainValue
+  {
+    int slice;
+    int column;
+    float value;
+  };
+
+  // A follow value of a context. A target of -1 clears its row, so that it backs off.
+  struct ContextValue
+  {
+    uint64 context;
+    int target;
+    float value;
+  };
+
+  ParameterEdit();
+
+  // replaces the value an earlier call set for the same parameter
+  void set(AudioProcessorParameter* parameter, float value);
+  // chain values are applied in the order they were set
+  void setFollow(int slice, int target, float value);
+  void clearFollow(int slice);
+  void setWarp(int slice, int warp, float value);
+  void setContextFollow(uint64 context, int target, float value);
+  void clearContext(uint64 context);
+  bool isEmpty() const;
+  // Until Processor::endGesture, a parameter's change gesture stays open from the first
+  // value applied, so that a whole drag is one gesture to the host.
+  void beginGesture();
+
+  std::vector<std::pair<AudioProcessorParameter*, float>> values;
+  // where each parameter is in values
+  std::unordered_map<AudioProcessorParameter*, std::size_t> valueIndices;
+  std::vector<ChainValue> follow;
+  std::vector<ChainValue> warp;
+  std::vector<ContextValue> context;
+  bool isGesture;
+  // the parameters whose gesture is open
+  std::unordered_set<AudioProcessorParameter*> gestures;
+};
+
+// Squared follow and warp probabilities per slice, ready to be drawn from. The follow
+// table only holds the transitions that can happen. Contexts longer than the order
+// aren't in the context table.
+struct SamplingTables
+{
+  SamplingTables();
+
+  SparseAliasTable follow;
+  std::array<AliasTable<numWarps>, maxNumSlices> warp;
+  int order;
+  ContextTable contexts;
+};
 
-class Processor : public AudioProcessor, private AudioProcessorValueTreeState::Listener
+class Processor : public AudioProcessor,
+                  private AudioProcessorValueTreeState::Listener,
+                  private Timer
 {
 public:
   Processor();
@@ -120,29 +357,170 @@ public:
   void getStateInformation(MemoryBlock& destData) override;
   void setStateInformation(const void* data, int sizeInBytes) override;
 
-  void openFile(const File& file);
+  // blocks until the file is loaded, false if it can't be
+  bool openFile(const File& file);
+  // loads in the background, playback switches over at the next slice
+  void loadFile(const File& file);
+  void cancelLoading();
+  // whether the state carries the audio of files that aren't streamed, or only refers
+  // to the file
+  void setEmbedAudio(bool embed);
+  bool getEmbedAudio() const;
+  bool isLoading() const;
+  double getLoadingProgress() const;
+  // Counts up to numParameterSlices are the numSlices parameter, larger ones a parameter
+  // of their own, so that numSlices keeps the range hosts have saved values for.
   int getNumSlices() const;
+  void setNumSlices(int numSlices);
   double getFadeDuration() const;
   int getSliceDurationIndex() const;
   double getSliceDuration() const;
+  Interpolation getInterpolation() const;
+  int getMarkovOrder() const;
+  Slicing getSlicing() const;
+  bool getSnapEdges() const;
+  int getSeed() const;
+  // the slices and warps drawn since playback last started over, oldest first
+  MarkovPath getRecordedPath() const;
+  // Makes the voices take their slices and warps from a path, from its start whenever
+  // playback starts over and from the chains once it is used up. With nullptr they
+  // draw from the chains again.
+  void replayPath(std::shared_ptr<const MarkovPath> path);
+  bool isReplaying() const;
+  // what processBlock costs, counted since the last reset
+  BlockStatsSnapshot getBlockStats() const;
+  void resetBlockStats();
+  int getCurrentSliceIndex() const;
+  StatePtr getState() const;
+  // the probabilities of chains with more slices than have parameters
+  float getChainFollow(int slice, int target) const;
+  float getChainWarp(int slice, int warp) const;
+  std::vector<SparseChain::Transition> getChainFollowRow(int slice) const;
+  // whether a context of two or more slices has a follow row of its own
+  bool hasContextRow(uint64 context) const;
+  // what a context follows with, from its own row or the one it backs off to
+  float getContextFollow(uint64 context, int target) const;
+  // Sets the values of an edit as one gesture and clears it. Only the values that differ
+  // are sent to the host, and the sampling tables are rebuilt once afterwards.
+  void applyEdit(ParameterEdit& edit);
+  void endGesture(ParameterEdit& edit);
+  void rebuildSamplingTables();
 
   AudioProcessorValueTreeState mParameters;
   FollowProbs pFollowProps;
   WarpProbs pWarpProps;
-  StatePtr pState;
+  // what the follow and warp parameters hold, to be read instead of them
+  FollowMatrix mFollowMatrix;
+  WarpMatrix mWarpMatrix;
   StateChanged mStateChanged;
-  std::array<Warp, numWarps> mWarps;
+  ParameterChanges mParameterChanges;
 
 private:
   void parameterChanged(const String& parameterID, float newValue) override;
-  void startNextSlice(StatePtr state);
-  void startSlice(StatePtr state, int slice, int warp, double hostProgress);
-  void processMidiMessages(StatePtr state, MidiBuffer& midiBuffer, double hostProgress);
-  int getNextSlice(int currentSlice, int numSlices);
-  int getWarp(int slice);
-
-  std::random_device randomDevice;
-  std::mt19937 randomGenerator;
+  void timerCallback() override;
+  void rebuildSlices();
+  void renderBlock(AudioSampleBuffer& buffer, MidiBuffer& midiBuffer);
+  void addContextRows(SamplingTables& tables, int numSlices);
+  void readState(MemoryInputStream& stream);
+  void readUnversionedState(MemoryInputStream& stream);
+  void publishSource(std::shared_ptr<SampleSource> original,
+                     std::shared_ptr<SampleSource> source,
+                     std::shared_ptr<const Onsets> onsets,
+                     std::shared_ptr<const ZeroCrossings> zeroCrossings);
+  const State* pinState(SampleSource::ScopedAccess& access);
+  SampleSource* getKeptSource(const State& state) const;
+  // what all voices share while rendering one block
+  struct Block
+  {
+    // the latest state pinned, voices that started their slice before play the kept one
+    const State* state;
+    SampleSource::ScopedAccess& access;
+    SampleSource::ScopedAccess& keptAccess;
+    const SamplingTables& tables;
+    float* const* channels;
+    int numChannels;
+    int numSamples;
+    double slicePerSample;
+    double hostProgress;
+    bool hostIsPlaying;
+
+    // how far the host is through the current slice at a sample of the block
+    double hostProgressAt(int sample) const;
+  };
+
+  bool isPlaying() const;
+  Voice* getLeadVoice();
+  Voice& getVoiceToSteal();
+  void startNote(Voice& voice,
+                 const Block& block,
+                 int note,
+                 double hostProgress,
+                 int sample);
+  void startNextSlice(Voice& voice,
+                      const SamplingTables& tables,
+                      int numSlices,
+                      int sample);
+  void startSlice(Voice& voice,
+                  const SamplingTables& tables,
+                  int numSlices,
+                  int slice,
+                  int warp,
+                  double hostProgress,
+                  int sample);
+  void renderVoices(Block& block, int start, int end);
+  void renderVoice(Voice& voice, Block& block, int start, int end, bool isLead);
+  bool haveOthersCaughtUp(const Voice& lead, const State* state) const;
+  void moveOnToLatestState(Block& block);
+  void renderRun(const State& state,
+                 const Slice& slice,
+                 const double* positions,
+                 int numSamples,
+                 const RenderTarget& target);
+  void prefetch(const State& state, const Voice& voice, double increment);
+  void processMidiMessage(const Block& block, const MidiMessage& message, int sample);
+  int getNextSlice(const SamplingTables& tables, const Voice& voice, int numSlices);
+  int getWarp(const SamplingTables& tables, int slice);
+  Decision decide(const SamplingTables& tables,
+                  const Voice& voice,
+                  int numSlices,
+                  int slice,
+                  int sample);
+  // reseeds the generator, and records and replays the path from its start again
+  void restartPath();
+
+  Xoshiro128 randomGenerator;
+  // samples rendered since playback last started over
+  int64 mSamplePosition;
+  std::atomic<bool> mReseed;
+  bool mHostWasPlaying;
+  PathRecorder mRecorder;
+  RcuPtr<MarkovPath> mReplay;
+  // counts the paths given to replay, a new one starts at its first decision even where
+  // it took the memory of the one before
+  std::atomic<uint32> mReplayGeneration;
+  uint32 mReplayedGeneration;
+  // the path being replayed in the current block, and the decision it is up to
+  const MarkovPath* mReplaying;
+  std::size_t mReplayIndex;
+  TripleBuffer<SamplingTables> mSamplingTables;
+  std::atomic<bool> mSamplingTablesDirty;
+  std::mutex mSamplingTablesMutex;
+  SparseChain mChain;
+  ContextChain mContexts;
+  // held while the chains change and while they are read
+  mutable std::mutex mChainMutex;
+  RcuPtr<State> mState;
+  FileLoader mLoader;
+  std::atomic<bool> mSlicesDirty;
+  std::atomic<bool> mEmbedAudio;
+  std::array<Voice, maxNumVoices> mVoices;
+  uint32 mNumStartedVoices;
+  std::atomic<int> mCurrentSliceIndex;
+  ParameterValues mValues;
+  std::array<RenderKernel, numInterpolations> mRenderKernels;
+  // the kernel of the quality chosen for the current block
+  RenderKernel mRenderKernel;
+  BlockStats mBlockStats;
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Processor)
 };
@@ -0,0 +1,129 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Warnings.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// The normalised values of a matrix of probability parameters in one cache aligned
+// block, next to their squares, which the sampling tables are built from, and the
+// running sums of the squares along each row. Kept up to date from the parameter
+// listener, so that building a table from a row touches no parameter objects and
+// doesn't sum it again. The block is allocated on its own and aligned by hand, as an
+// over-aligned member would make the processor over-aligned for new before C++17.
+template <std::size_t Rows, std::size_t Columns>
+class ProbabilityMatrix
+{
+public:
+  ProbabilityMatrix();
+  ProbabilityMatrix(const ProbabilityMatrix&) = delete;
+  ProbabilityMatrix& operator=(const ProbabilityMatrix&) = delete;
+
+  void set(int row, int column, float value);
+  float value(int row, int column) const;
+  // the squared values of a row
+  const float* weights(int row) const;
+  // the sum of the first numColumns weights of a row
+  double weightSum(int row, int numColumns) const;
+
+private:
+  static const std::size_t cacheLine = 64;
+  static std::size_t padded(std::size_t bytes);
+
+  std::vector<char> mStorage;
+  float* mValues;
+  float* mWeights;
+  // Columns + 1 per row, the first one 0
+  double* mSums;
+};
+
+template <std::size_t Rows, std::size_t Columns>
+ProbabilityMatrix<Rows, Columns>::ProbabilityMatrix()
+{
+  const std::size_t valueBytes = padded(Rows * Columns * sizeof(float));
+  const std::size_t sumBytes = padded(Rows * (Columns + 1) * sizeof(double));
+  mStorage.resize(cacheLine + 2 * valueBytes + sumBytes);
+  const std::size_t address = reinterpret_cast<std::uintptr_t>(mStorage.data());
+  char* block = mStorage.data() + (cacheLine - address % cacheLine) % cacheLine;
+
+  mValues = reinterpret_cast<float*>(block);
+  mWeights = reinterpret_cast<float*>(block + valueBytes);
+  mSums = reinterpret_cast<double*>(block + 2 * valueBytes);
+  std::uninitialized_fill_n(mValues, Rows * Columns, 0.f);
+  std::uninitialized_fill_n(mWeights, Rows * Columns, 0.f);
+  std::uninitialized_fill_n(mSums, Rows * (Columns + 1), 0.);
+}
+
+template <std::size_t Rows, std::size_t Columns>
+void ProbabilityMatrix<Rows, Columns>::set(const int row,
+                                           const int column,
+                                           const float value)
+{
+  const std::size_t i = static_cast<std::size_t>(row);
+  const std::size_t j = static_cast<std::size_t>(column);
+  mValues[i * Columns + j] = value;
+  mWeights[i * Columns + j] = value * value;
+
+  // in the order the tables would sum them, so that the sums come out the same
+  const float* weights = mWeights + i * Columns;
+  double* sums = mSums + i * (Columns + 1);
+  for (std::size_t k = j; k < Columns; ++k)
+  {
+    sums[k + 1] = sums[k] + static_cast<double>(weights[k]);
+  }
+}
+
+template <std::size_t Rows, std::size_t Columns>
+float ProbabilityMatrix<Rows, Columns>::value(const int row, const int column) const
+{
+  return mValues[static_cast<std::size_t>(row) * Columns
+                 + static_cast<std::size_t>(column)];
+}
+
+template <std::size_t Rows, std::size_t Columns>
+const float* ProbabilityMatrix<Rows, Columns>::weights(const int row) const
+{
+  return mWeights + static_cast<std::size_t>(row) * Columns;
+}
+
+template <std::size_t Rows, std::size_t Columns>
+double ProbabilityMatrix<Rows, Columns>::weightSum(const int row,
+                                                   const int numColumns) const
+{
+  return mSums[static_cast<std::size_t>(row) * (Columns + 1)
+               + static_cast<std::size_t>(numColumns)];
+}
+
+template <std::size_t Rows, std::size_t Columns>
+std::size_t ProbabilityMatrix<Rows, Columns>::padded(const std::size_t bytes)
+{
+  return (bytes + cacheLine - 1) / cacheLine * cacheLine;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
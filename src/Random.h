@@ -0,0 +1,121 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Warnings.h"
+#include <array>
+#include <cstdint>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// xoshiro128** by Blackman and Vigna: 16 bytes of state and a few instructions per
+// number, for drawing slices and warps on the audio thread. Seeds are spread with
+// splitmix64, so that neighbouring seeds give unrelated sequences. Meets the
+// requirements of a uniform random bit generator.
+class Xoshiro128
+{
+public:
+  using result_type = uint32_t;
+
+  explicit Xoshiro128(uint64_t seed = 0);
+
+  void seed(uint64_t seed);
+  result_type operator()();
+
+  static constexpr result_type min()
+  {
+    return 0;
+  }
+
+  static constexpr result_type max()
+  {
+    return UINT32_MAX;
+  }
+
+private:
+  static uint32_t rotl(uint32_t x, int k);
+
+  std::array<uint32_t, 4> mState;
+};
+
+inline Xoshiro128::Xoshiro128(const uint64_t seed)
+{
+  this->seed(seed);
+}
+
+inline void Xoshiro128::seed(uint64_t seed)
+{
+  for (std::size_t i = 0; i < mState.size(); i += 2)
+  {
+    seed += 0x9e3779b97f4a7c15;
+    uint64_t z = seed;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    z ^= z >> 31;
+    mState[i] = static_cast<uint32_t>(z);
+    mState[i + 1] = static_cast<uint32_t>(z >> 32);
+  }
+}
+
+inline Xoshiro128::result_type Xoshiro128::operator()()
+{
+  const uint32_t result = rotl(mState[1] * 5, 7) * 9;
+  const uint32_t t = mState[1] << 9;
+  mState[2] ^= mState[0];
+  mState[3] ^= mState[1];
+  mState[1] ^= mState[2];
+  mState[0] ^= mState[3];
+  mState[2] ^= t;
+  mState[3] = rotl(mState[3], 11);
+  return result;
+}
+
+inline uint32_t Xoshiro128::rotl(const uint32_t x, const int k)
+{
+  return (x << k) | (x >> (32 - k));
+}
+
+// Draws from the 32 bits of a generator like Xoshiro128. Unlike the std distributions,
+// whose algorithms differ between standard libraries, these map the bits the same way
+// on every platform, so that a seed plays the same take everywhere.
+// An integer in [0, n), by multiplying and keeping the upper half.
+template <typename Generator>
+int drawBelow(Generator& generator, const int n)
+{
+  static_assert(Generator::min() == 0 && Generator::max() == UINT32_MAX,
+                "needs 32 random bits");
+  return static_cast<int>((static_cast<uint64_t>(generator()) * static_cast<uint32_t>(n))
+                          >> 32);
+}
+
+// A float in [0, 1) from the upper 24 bits, as many as it has mantissa.
+template <typename Generator>
+float drawUnit(Generator& generator)
+{
+  static_assert(Generator::min() == 0 && Generator::max() == UINT32_MAX,
+                "needs 32 random bits");
+  return static_cast<float>(generator() >> 8) * (1.f / 16777216.f);
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,178 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Warnings.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Read-copy-update pointer with a single realtime reader. Writers publish immutable
+// values from any other thread. The realtime reader pins the value it works on with a
+// hazard pointer and keeps it, across calls, until it pins the latest one. It never
+// blocks, allocates or frees. Replaced values are destroyed on a background thread once
+// they are no longer pinned. The reader may keep one earlier value alive next to the
+// pinned one while it finishes with it.
+template <typename T>
+class RcuPtr
+{
+public:
+  RcuPtr();
+  ~RcuPtr();
+
+  void publish(std::shared_ptr<const T> value);
+  std::shared_ptr<const T> get() const;
+
+  // realtime reader only
+  const T* pin();
+  const T* pinned() const;
+  void keep(const T* value);
+  const T* kept() const;
+
+private:
+  void reclaim();
+
+  std::atomic<const T*> mCurrent;
+  std::atomic<const T*> mHazard;
+  std::atomic<const T*> mKept;
+  mutable std::mutex mMutex;
+  std::condition_variable mWakeUp;
+  std::shared_ptr<const T> mOwner;
+  std::vector<std::shared_ptr<const T>> mRetired;
+  bool mExit;
+  std::thread mReclaimer;
+};
+
+template <typename T>
+RcuPtr<T>::RcuPtr()
+  : mCurrent(nullptr)
+  , mHazard(nullptr)
+  , mKept(nullptr)
+  , mExit(false)
+  , mReclaimer([this] { reclaim(); })
+{
+}
+
+template <typename T>
+RcuPtr<T>::~RcuPtr()
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mExit = true;
+  }
+  mWakeUp.notify_one();
+  mReclaimer.join();
+}
+
+template <typename T>
+void RcuPtr<T>::publish(std::shared_ptr<const T> value)
+{
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCurrent.store(value.get());
+    if (mOwner)
+    {
+      mRetired.push_back(std::move(mOwner));
+    }
+    mOwner = std::move(value);
+  }
+  mWakeUp.notify_one();
+}
+
+template <typename T>
+std::shared_ptr<const T> RcuPtr<T>::get() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mOwner;
+}
+
+template <typename T>
+const T* RcuPtr<T>::pin()
+{
+  const T* value = mCurrent.load();
+  for (;;)
+  {
+    mHazard.store(value);
+    const T* current = mCurrent.load();
+    if (current == value)
+    {
+      return value;
+    }
+    value = current;
+  }
+}
+
+template <typename T>
+const T* RcuPtr<T>::pinned() const
+{
+  return mHazard.load();
+}
+
+// The value kept has to be pinned or kept already, it stays safe while it is moved
+// from one hazard to the other.
+template <typename T>
+void RcuPtr<T>::keep(const T* value)
+{
+  mKept.store(value);
+}
+
+template <typename T>
+const T* RcuPtr<T>::kept() const
+{
+  return mKept.load();
+}
+
+template <typename T>
+void RcuPtr<T>::reclaim()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (!mExit)
+  {
+    mWakeUp.wait_for(lock, std::chrono::milliseconds(100));
+
+    std::vector<std::shared_ptr<const T>> garbage;
+    garbage.swap(mRetired);
+    // the hazard before the kept value, which the reader sets before it pins another
+    const T* hazard = mHazard.load();
+    const T* kept = mKept.load();
+    for (auto& retired : garbage)
+    {
+      if (retired.get() == hazard || retired.get() == kept)
+      {
+        mRetired.push_back(std::move(retired));
+      }
+    }
+
+    lock.unlock();
+    garbage.clear();
+    lock.lock();
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,658 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Render.h"
+#include "Warnings.h"
+#include <algorithm>
+
+#if JUCE_INTEL
+#include <immintrin.h>
+#if JUCE_GCC || JUCE_CLANG
+#define BREAKOV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BREAKOV_TARGET_AVX2
+#endif
+#endif
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const int sincTaps = 2 * interpolationReach;
+const int sincPhases = 256;
+
+double inverseFade(const RenderSource& source)
+{
+  return source.fadeSamples > 0 ? 1. / source.fadeSamples : 0.;
+}
+
+// added to the fade gain, so that no fade at all ends up as a gain of 1
+double fadeBias(const RenderSource& source)
+{
+  return source.fadeSamples > 0 ? 0. : 1.;
+}
+
+RenderTarget advanced(const RenderTarget& target, const int numSamples)
+{
+  return {target.channels, target.numChannels, target.offset + numSamples,
+          target.gain + numSamples * target.gainIncrement, target.gainIncrement};
+}
+
+// the fade at both ends of the source times the gain ramp of the target at sample i
+float gainAt(const RenderSource& source,
+             const RenderTarget& target,
+             const double position,
+             const int i,
+             const double invFade,
+             const double bias)
+{
+  const double fade =
+    std::min(1., std::min(position, source.lastIndex - position) * invFade + bias);
+  return static_cast<float>(fade) * (target.gain + i * target.gainIncrement);
+}
+
+float hermite(
+  const float x, const float ym1, const float y0, const float y1, const float y2)
+{
+  const float c1 = 0.5f * (y1 - ym1);
+  const float c2 = ym1 - 2.5f * y0 + 2.f * y1 - 0.5f * y2;
+  const float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+  return ((c3 * x + c2) * x + c1) * x + y0;
+}
+
+// Blackman windowed sinc taps for the fractional positions 0, 1 / sincPhases, .., 1,
+// each row scaled to unity gain. Tap j weighs the frame at lo + 1 - interpolationReach
+// + j.
+struct SincTable
+{
+  SincTable();
+
+  alignas(32) float taps[sincPhases + 1][sincTaps];
+};
+
+SincTable::SincTable()
+{
+  for (int phase = 0; phase <= sincPhases; ++phase)
+  {
+    const double x = static_cast<double>(phase) / sincPhases;
+    double sum = 0;
+    for (int j = 0; j < sincTaps; ++j)
+    {
+      const double d = x + interpolationReach - 1 - j;
+      const double sinc = d == 0 ? 1. : sin(double_Pi * d) / (double_Pi * d);
+      const double window = 0.42 + 0.5 * cos(double_Pi * d / interpolationReach)
+                            + 0.08 * cos(2 * double_Pi * d / interpolationReach);
+      taps[phase][j] = static_cast<float>(sinc * window);
+      sum += taps[phase][j];
+    }
+    for (int j = 0; j < sincTaps; ++j)
+    {
+      taps[phase][j] = static_cast<float>(taps[phase][j] / sum);
+    }
+  }
+}
+
+const SincTable& sincTable()
+{
+  static const SincTable table;
+  return table;
+}
+
+// the rows around the fractional position x, and how far x lies between them
+const float* sincRow(const double x, float& fraction)
+{
+  const double scaled = x * sincPhases;
+  const int phase = static_cast<int>(scaled);
+  fraction = static_cast<float>(scaled - phase);
+  return sincTable().taps[phase];
+}
+
+// the tap weights for a position, and whether all its frames lie within the source
+bool sincTapsAt(const RenderSource& source, const double position, int& lo, float* taps)
+{
+  lo = static_cast<int>(position);
+  float fraction;
+  const float* a = sincRow(position - lo, fraction);
+  const float* b = a + sincTaps;
+  for (int j = 0; j < sincTaps; ++j)
+  {
+    taps[j] = a[j] + fraction * (b[j] - a[j]);
+  }
+  return lo + 1 - interpolationReach >= 0 && lo + interpolationReach <= source.lastIndex;
+}
+
+// one output sample of a channel, with the reads clamped to the source
+float sincClamped(const RenderSource& source,
+                  const float* src,
+                  const int lo,
+                  const float* taps)
+{
+  float sum = 0;
+  for (int j = 0; j < sincTaps; ++j)
+  {
+    const int index = jlimit(0, source.lastIndex, lo + 1 - interpolationReach + j);
+    sum += taps[j] * src[index];
+  }
+  return sum;
+}
+} // namespace
+
+void renderLinearScalar(const RenderSource& source,
+                        const double* positions,
+                        const int numSamples,
+                        const RenderTarget& target)
+{
+  const double invFade = inverseFade(source);
+  const double bias = fadeBias(source);
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const double position = positions[i];
+    const int lo = static_cast<int>(position);
+    const int hi = std::min(lo + 1, source.lastIndex);
+    const float x = static_cast<float>(position - lo);
+    const float gain = gainAt(source, target, position, i, invFade, bias);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      target.channels[channel][target.offset + i] +=
+        gain * (src[lo] + x * (src[hi] - src[lo]));
+    }
+  }
+}
+
+void renderHermiteScalar(const RenderSource& source,
+                         const double* positions,
+                         const int numSamples,
+                         const RenderTarget& target)
+{
+  const double invFade = inverseFade(source);
+  const double bias = fadeBias(source);
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const double position = positions[i];
+    const int lo = static_cast<int>(position);
+    const int before = std::max(lo - 1, 0);
+    const int hi = std::min(lo + 1, source.lastIndex);
+    const int after = std::min(lo + 2, source.lastIndex);
+    const float x = static_cast<float>(position - lo);
+    const float gain = gainAt(source, target, position, i, invFade, bias);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      target.channels[channel][target.offset + i] +=
+        gain * hermite(x, src[before], src[lo], src[hi], src[after]);
+    }
+  }
+}
+
+void renderSincScalar(const RenderSource& source,
+                      const double* positions,
+                      const int numSamples,
+                      const RenderTarget& target)
+{
+  const double invFade = inverseFade(source);
+  const double bias = fadeBias(source);
+  float taps[sincTaps];
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    int lo;
+    sincTapsAt(source, positions[i], lo, taps);
+    const float gain = gainAt(source, target, positions[i], i, invFade, bias);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      target.channels[channel][target.offset + i] +=
+        gain * sincClamped(source, src, lo, taps);
+    }
+  }
+}
+
+#if JUCE_INTEL
+
+namespace
+{
+// there is no _mm_min_epi32 or _mm_max_epi32 before SSE4.1
+__m128i minEpi32(const __m128i a, const __m128i b)
+{
+  const __m128i greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+}
+
+__m128i maxEpi32(const __m128i a, const __m128i b)
+{
+  const __m128i greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+}
+
+// the integer and fractional parts of four positions
+void splitSse2(const double* positions, __m128i& lo, __m128& x)
+{
+  const __m128d p0 = _mm_loadu_pd(positions);
+  const __m128d p1 = _mm_loadu_pd(positions + 2);
+  const __m128i lo0 = _mm_cvttpd_epi32(p0);
+  const __m128i lo1 = _mm_cvttpd_epi32(p1);
+  lo = _mm_unpacklo_epi64(lo0, lo1);
+  x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_sub_pd(p0, _mm_cvtepi32_pd(lo0))),
+                    _mm_cvtpd_ps(_mm_sub_pd(p1, _mm_cvtepi32_pd(lo1))));
+}
+
+// gainAt() for the four samples from i on
+__m128 gainSse2(const RenderSource& source,
+                const RenderTarget& target,
+                const double* positions,
+                const int i,
+                const __m128d invFade,
+                const __m128d bias)
+{
+  const __m128d last = _mm_set1_pd(source.lastIndex);
+  const __m128d one = _mm_set1_pd(1.);
+  const __m128d p0 = _mm_loadu_pd(positions);
+  const __m128d p1 = _mm_loadu_pd(positions + 2);
+  const __m128d g0 = _mm_min_pd(
+    one, _mm_add_pd(_mm_mul_pd(_mm_min_pd(p0, _mm_sub_pd(last, p0)), invFade), bias));
+  const __m128d g1 = _mm_min_pd(
+    one, _mm_add_pd(_mm_mul_pd(_mm_min_pd(p1, _mm_sub_pd(last, p1)), invFade), bias));
+  const __m128 ramp =
+    _mm_add_ps(_mm_set1_ps(target.gain + i * target.gainIncrement),
+               _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(target.gainIncrement)));
+  return _mm_mul_ps(_mm_movelh_ps(_mm_cvtpd_ps(g0), _mm_cvtpd_ps(g1)), ramp);
+}
+
+__m128 gatherSse2(const float* src, const int* index)
+{
+  return _mm_setr_ps(src[index[0]], src[index[1]], src[index[2]], src[index[3]]);
+}
+
+void accumulateSse2(float* dst, const __m128 gain, const __m128 sample)
+{
+  _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(gain, sample)));
+}
+
+float horizontalSumSse2(const __m128 v)
+{
+  const __m128 pairs = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+
+void renderLinearSse2(const RenderSource& source,
+                      const double* positions,
+                      const int numSamples,
+                      const RenderTarget& target)
+{
+  const __m128i last = _mm_set1_epi32(source.lastIndex);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128d invFade = _mm_set1_pd(inverseFade(source));
+  const __m128d bias = _mm_set1_pd(fadeBias(source));
+
+  int i = 0;
+  for (; i + 4 <= numSamples; i += 4)
+  {
+    __m128i lo;
+    __m128 x;
+    splitSse2(positions + i, lo, x);
+    const __m128i hi = minEpi32(_mm_add_epi32(lo, one), last);
+    const __m128 gain = gainSse2(source, target, positions + i, i, invFade, bias);
+
+    alignas(16) int loIndex[4];
+    alignas(16) int hiIndex[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(loIndex), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(hiIndex), hi);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      const __m128 a = gatherSse2(src, loIndex);
+      const __m128 b = gatherSse2(src, hiIndex);
+      accumulateSse2(target.channels[channel] + target.offset + i, gain,
+                     _mm_add_ps(a, _mm_mul_ps(x, _mm_sub_ps(b, a))));
+    }
+  }
+
+  renderLinearScalar(source, positions + i, numSamples - i, advanced(target, i));
+}
+
+void renderHermiteSse2(const RenderSource& source,
+                       const double* positions,
+                       const int numSamples,
+                       const RenderTarget& target)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i last = _mm_set1_epi32(source.lastIndex);
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  const __m128d invFade = _mm_set1_pd(inverseFade(source));
+  const __m128d bias = _mm_set1_pd(fadeBias(source));
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 oneAndHalf = _mm_set1_ps(1.5f);
+  const __m128 twoAndHalf = _mm_set1_ps(2.5f);
+  const __m128 twoF = _mm_set1_ps(2.f);
+
+  int i = 0;
+  for (; i + 4 <= numSamples; i += 4)
+  {
+    __m128i lo;
+    __m128 x;
+    splitSse2(positions + i, lo, x);
+    const __m128 gain = gainSse2(source, target, positions + i, i, invFade, bias);
+
+    alignas(16) int index[4][4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(index[0]),
+                    maxEpi32(_mm_sub_epi32(lo, one), zero));
+    _mm_store_si128(reinterpret_cast<__m128i*>(index[1]), lo);
+    _mm_store_si128(reinterpret_cast<__m128i*>(index[2]),
+                    minEpi32(_mm_add_epi32(lo, one), last));
+    _mm_store_si128(reinterpret_cast<__m128i*>(index[3]),
+                    minEpi32(_mm_add_epi32(lo, two), last));
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      const __m128 ym1 = gatherSse2(src, index[0]);
+      const __m128 y0 = gatherSse2(src, index[1]);
+      const __m128 y1 = gatherSse2(src, index[2]);
+      const __m128 y2 = gatherSse2(src, index[3]);
+
+      const __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(y1, ym1));
+      const __m128 c2 =
+        _mm_sub_ps(_mm_add_ps(ym1, _mm_mul_ps(twoF, y1)),
+                   _mm_add_ps(_mm_mul_ps(twoAndHalf, y0), _mm_mul_ps(half, y2)));
+      const __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(y2, ym1)),
+                                   _mm_mul_ps(oneAndHalf, _mm_sub_ps(y0, y1)));
+      const __m128 cubic = _mm_add_ps(_mm_mul_ps(c3, x), c2);
+      const __m128 sample =
+        _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(cubic, x), c1), x), y0);
+      accumulateSse2(target.channels[channel] + target.offset + i, gain, sample);
+    }
+  }
+
+  renderHermiteScalar(source, positions + i, numSamples - i, advanced(target, i));
+}
+
+// Vectorised over the taps of one output sample rather than over output samples, the
+// frames of a sample lie next to each other.
+void renderSincSse2(const RenderSource& source,
+                    const double* positions,
+                    const int numSamples,
+                    const RenderTarget& target)
+{
+  const double invFade = inverseFade(source);
+  const double bias = fadeBias(source);
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const double position = positions[i];
+    const int lo = static_cast<int>(position);
+    const float gain = gainAt(source, target, position, i, invFade, bias);
+
+    float fraction;
+    const float* a = sincRow(position - lo, fraction);
+    const __m128 f = _mm_set1_ps(fraction);
+    const __m128 a0 = _mm_load_ps(a);
+    const __m128 a1 = _mm_load_ps(a + 4);
+    const __m128 taps0 =
+      _mm_add_ps(a0, _mm_mul_ps(f, _mm_sub_ps(_mm_load_ps(a + 8), a0)));
+    const __m128 taps1 =
+      _mm_add_ps(a1, _mm_mul_ps(f, _mm_sub_ps(_mm_load_ps(a + 12), a1)));
+
+    if (lo + 1 - interpolationReach < 0 || lo + interpolationReach > source.lastIndex)
+    {
+      alignas(16) float taps[sincTaps];
+      _mm_store_ps(taps, taps0);
+      _mm_store_ps(taps + 4, taps1);
+      for (int channel = 0; channel < target.numChannels; ++channel)
+      {
+        const float* src = source.channels[channel % source.numChannels] + source.offset;
+        target.channels[channel][target.offset + i] +=
+          gain * sincClamped(source, src, lo, taps);
+      }
+      continue;
+    }
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset
+                         + lo + 1 - interpolationReach;
+      const __m128 sum = _mm_add_ps(_mm_mul_ps(taps0, _mm_loadu_ps(src)),
+                                    _mm_mul_ps(taps1, _mm_loadu_ps(src + 4)));
+      target.channels[channel][target.offset + i] += gain * horizontalSumSse2(sum);
+    }
+  }
+}
+
+BREAKOV_TARGET_AVX2 void splitAvx2(const double* positions, __m256i& lo, __m256& x)
+{
+  const __m256d p0 = _mm256_loadu_pd(positions);
+  const __m256d p1 = _mm256_loadu_pd(positions + 4);
+  const __m128i lo0 = _mm256_cvttpd_epi32(p0);
+  const __m128i lo1 = _mm256_cvttpd_epi32(p1);
+  lo = _mm256_inserti128_si256(_mm256_castsi128_si256(lo0), lo1, 1);
+  const __m128 x0 = _mm256_cvtpd_ps(_mm256_sub_pd(p0, _mm256_cvtepi32_pd(lo0)));
+  const __m128 x1 = _mm256_cvtpd_ps(_mm256_sub_pd(p1, _mm256_cvtepi32_pd(lo1)));
+  x = _mm256_insertf128_ps(_mm256_castps128_ps256(x0), x1, 1);
+}
+
+BREAKOV_TARGET_AVX2 __m256 gainAvx2(const RenderSource& source,
+                                    const RenderTarget& target,
+                                    const double* positions,
+                                    const int i,
+                                    const __m256d invFade,
+                                    const __m256d bias)
+{
+  const __m256d last = _mm256_set1_pd(source.lastIndex);
+  const __m256d one = _mm256_set1_pd(1.);
+  const __m256d p0 = _mm256_loadu_pd(positions);
+  const __m256d p1 = _mm256_loadu_pd(positions + 4);
+  const __m256d g0 = _mm256_min_pd(
+    one,
+    _mm256_add_pd(_mm256_mul_pd(_mm256_min_pd(p0, _mm256_sub_pd(last, p0)), invFade),
+                  bias));
+  const __m256d g1 = _mm256_min_pd(
+    one,
+    _mm256_add_pd(_mm256_mul_pd(_mm256_min_pd(p1, _mm256_sub_pd(last, p1)), invFade),
+                  bias));
+  const __m256 ramp =
+    _mm256_add_ps(_mm256_set1_ps(target.gain + i * target.gainIncrement),
+                  _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7),
+                                _mm256_set1_ps(target.gainIncrement)));
+  return _mm256_mul_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(g0)),
+                                            _mm256_cvtpd_ps(g1), 1),
+                       ramp);
+}
+
+BREAKOV_TARGET_AVX2 void accumulateAvx2(float* dst,
+                                        const __m256 gain,
+                                        const __m256 sample)
+{
+  _mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), _mm256_mul_ps(gain, sample)));
+}
+
+BREAKOV_TARGET_AVX2 void renderLinearAvx2(const RenderSource& source,
+                                          const double* positions,
+                                          const int numSamples,
+                                          const RenderTarget& target)
+{
+  const __m256i last = _mm256_set1_epi32(source.lastIndex);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256d invFade = _mm256_set1_pd(inverseFade(source));
+  const __m256d bias = _mm256_set1_pd(fadeBias(source));
+
+  int i = 0;
+  for (; i + 8 <= numSamples; i += 8)
+  {
+    __m256i lo;
+    __m256 x;
+    splitAvx2(positions + i, lo, x);
+    const __m256i hi = _mm256_min_epi32(_mm256_add_epi32(lo, one), last);
+    const __m256 gain = gainAvx2(source, target, positions + i, i, invFade, bias);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      const __m256 a = _mm256_i32gather_ps(src, lo, 4);
+      const __m256 b = _mm256_i32gather_ps(src, hi, 4);
+      accumulateAvx2(target.channels[channel] + target.offset + i, gain,
+                     _mm256_add_ps(a, _mm256_mul_ps(x, _mm256_sub_ps(b, a))));
+    }
+  }
+
+  renderLinearScalar(source, positions + i, numSamples - i, advanced(target, i));
+}
+
+BREAKOV_TARGET_AVX2 void renderHermiteAvx2(const RenderSource& source,
+                                           const double* positions,
+                                           const int numSamples,
+                                           const RenderTarget& target)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i last = _mm256_set1_epi32(source.lastIndex);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256d invFade = _mm256_set1_pd(inverseFade(source));
+  const __m256d bias = _mm256_set1_pd(fadeBias(source));
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 oneAndHalf = _mm256_set1_ps(1.5f);
+  const __m256 twoAndHalf = _mm256_set1_ps(2.5f);
+  const __m256 twoF = _mm256_set1_ps(2.f);
+
+  int i = 0;
+  for (; i + 8 <= numSamples; i += 8)
+  {
+    __m256i lo;
+    __m256 x;
+    splitAvx2(positions + i, lo, x);
+    const __m256 gain = gainAvx2(source, target, positions + i, i, invFade, bias);
+    const __m256i before = _mm256_max_epi32(_mm256_sub_epi32(lo, one), zero);
+    const __m256i hi = _mm256_min_epi32(_mm256_add_epi32(lo, one), last);
+    const __m256i after = _mm256_min_epi32(_mm256_add_epi32(lo, two), last);
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset;
+      const __m256 ym1 = _mm256_i32gather_ps(src, before, 4);
+      const __m256 y0 = _mm256_i32gather_ps(src, lo, 4);
+      const __m256 y1 = _mm256_i32gather_ps(src, hi, 4);
+      const __m256 y2 = _mm256_i32gather_ps(src, after, 4);
+
+      const __m256 c1 = _mm256_mul_ps(half, _mm256_sub_ps(y1, ym1));
+      const __m256 c2 = _mm256_sub_ps(
+        _mm256_add_ps(ym1, _mm256_mul_ps(twoF, y1)),
+        _mm256_add_ps(_mm256_mul_ps(twoAndHalf, y0), _mm256_mul_ps(half, y2)));
+      const __m256 c3 = _mm256_add_ps(_mm256_mul_ps(half, _mm256_sub_ps(y2, ym1)),
+                                      _mm256_mul_ps(oneAndHalf, _mm256_sub_ps(y0, y1)));
+      const __m256 cubic = _mm256_add_ps(_mm256_mul_ps(c3, x), c2);
+      const __m256 sample = _mm256_add_ps(
+        _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(cubic, x), c1), x), y0);
+      accumulateAvx2(target.channels[channel] + target.offset + i, gain, sample);
+    }
+  }
+
+  renderHermiteScalar(source, positions + i, numSamples - i, advanced(target, i));
+}
+
+// all eight taps of a sample in one register
+BREAKOV_TARGET_AVX2 void renderSincAvx2(const RenderSource& source,
+                                        const double* positions,
+                                        const int numSamples,
+                                        const RenderTarget& target)
+{
+  const double invFade = inverseFade(source);
+  const double bias = fadeBias(source);
+
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const double position = positions[i];
+    const int lo = static_cast<int>(position);
+    const float gain = gainAt(source, target, position, i, invFade, bias);
+
+    float fraction;
+    const float* row = sincRow(position - lo, fraction);
+    const __m256 a = _mm256_load_ps(row);
+    const __m256 taps = _mm256_add_ps(
+      a,
+      _mm256_mul_ps(_mm256_set1_ps(fraction), _mm256_sub_ps(_mm256_load_ps(row + 8), a)));
+
+    if (lo + 1 - interpolationReach < 0 || lo + interpolationReach > source.lastIndex)
+    {
+      alignas(32) float clamped[sincTaps];
+      _mm256_store_ps(clamped, taps);
+      for (int channel = 0; channel < target.numChannels; ++channel)
+      {
+        const float* src = source.channels[channel % source.numChannels] + source.offset;
+        target.channels[channel][target.offset + i] +=
+          gain * sincClamped(source, src, lo, clamped);
+      }
+      continue;
+    }
+
+    for (int channel = 0; channel < target.numChannels; ++channel)
+    {
+      const float* src = source.channels[channel % source.numChannels] + source.offset
+                         + lo + 1 - interpolationReach;
+      const __m256 products = _mm256_mul_ps(taps, _mm256_loadu_ps(src));
+      const __m128 sum = _mm_add_ps(_mm256_castps256_ps128(products),
+                                    _mm256_extractf128_ps(products, 1));
+      target.channels[channel][target.offset + i] += gain * horizontalSumSse2(sum);
+    }
+  }
+}
+} // namespace
+
+#endif
+
+RenderKernel renderKernel(const Interpolation interpolation)
+{
+  // built here rather than on the audio thread
+  sincTable();
+
+#if JUCE_INTEL
+  const bool avx2 = SystemStats::hasAVX2();
+  const bool sse2 = SystemStats::hasSSE2();
+  switch (interpolation)
+  {
+  case Interpolation::linear:
+    return avx2 ? &renderLinearAvx2 : sse2 ? &renderLinearSse2 : &renderLinearScalar;
+  case Interpolation::hermite:
+    return avx2 ? &renderHermiteAvx2 : sse2 ? &renderHermiteSse2 : &renderHermiteScalar;
+  case Interpolation::sinc:
+    return avx2 ? &renderSincAvx2 : sse2 ? &renderSincSse2 : &renderSincScalar;
+  }
+#endif
+
+  switch (interpolation)
+  {
+  case Interpolation::hermite:
+    return &renderHermiteScalar;
+  case Interpolation::sinc:
+    return &renderSincScalar;
+  default:
+    return &renderLinearScalar;
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,92 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Warnings.h"
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// A span of planar source samples, read relative to offset. Reads are faded in and out
+// over fadeSamples at both ends of the span.
+struct RenderSource
+{
+  const float* const* channels;
+  int numChannels;
+  int offset;
+  int lastIndex;
+  double fadeSamples;
+};
+
+// Output channels, written from offset on. The rendered samples are scaled by a gain
+// that starts at gain and changes by gainIncrement per sample.
+struct RenderTarget
+{
+  float* const* channels;
+  int numChannels;
+  int offset;
+  float gain;
+  float gainIncrement;
+};
+
+// Interpolates the source at numSamples read positions and adds the result to every
+// target channel. Target channel c reads source channel c % source.numChannels.
+// Positions must lie within 0..source.lastIndex, reads around them are clamped to that
+// range.
+using RenderKernel = void (*)(const RenderSource& source,
+                              const double* positions,
+                              int numSamples,
+                              const RenderTarget& target);
+
+// In the order of the quality parameter. Linear reads 2 source frames per output
+// sample, hermite 4 and sinc 8.
+enum class Interpolation
+{
+  linear,
+  hermite,
+  sinc
+};
+
+const static int numInterpolations = 3;
+
+// frames any interpolation reads before and after a position, at most
+const static int interpolationReach = 4;
+
+void renderLinearScalar(const RenderSource& source,
+                        const double* positions,
+                        int numSamples,
+                        const RenderTarget& target);
+
+void renderHermiteScalar(const RenderSource& source,
+                         const double* positions,
+                         int numSamples,
+                         const RenderTarget& target);
+
+void renderSincScalar(const RenderSource& source,
+                      const double* positions,
+                      int numSamples,
+                      const RenderTarget& target);
+
+// the fastest kernel for the interpolation the cpu supports: AVX2, SSE2 or scalar
+RenderKernel renderKernel(Interpolation interpolation);
+
+} // namespace breakov
+
+POP_WARNINGS
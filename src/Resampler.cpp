@@ -0,0 +1,166 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Resampler.h"
+#include "Warnings.h"
+#include "Workers.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const int numZeroCrossings = 32;
+const int numPhases = 512;
+const double kaiserBeta = 9.;
+// the passband edge relative to the lower of the two Nyquist frequencies
+const double passband = 0.95;
+// output samples per job
+const int segmentSize = 1 << 15;
+
+double besselI0(const double x)
+{
+  double sum = 1;
+  double term = 1;
+  for (int k = 1; k < 32; ++k)
+  {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// One side of the windowed sinc, numPhases values per zero crossing and zeros after the
+// last one, so that interpolating between neighbours never reads past the end.
+std::vector<float> makeKernel()
+{
+  std::vector<float> kernel(numZeroCrossings * numPhases + 2, 0.f);
+  for (int i = 0; i < numZeroCrossings * numPhases; ++i)
+  {
+    const double x = static_cast<double>(i) / numPhases;
+    const double r = x / numZeroCrossings;
+    const double sinc = i == 0 ? 1. : sin(double_Pi * x) / (double_Pi * x);
+    const double window = besselI0(kaiserBeta * sqrt(1 - r * r)) / besselI0(kaiserBeta);
+    kernel[static_cast<std::size_t>(i)] = static_cast<float>(sinc * window);
+  }
+  return kernel;
+}
+
+const std::vector<float>& kernel()
+{
+  static const std::vector<float> kernel = makeKernel();
+  return kernel;
+}
+
+class ResampleJob : public ThreadPoolJob
+{
+public:
+  ResampleJob(const float* input,
+              int numInput,
+              float* output,
+              int first,
+              int last,
+              double step)
+    : ThreadPoolJob("breakov resample")
+    , mInput(input)
+    , mNumInput(numInput)
+    , mOutput(output)
+    , mFirst(first)
+    , mLast(last)
+    , mStep(step)
+  {
+  }
+
+  JobStatus runJob() override
+  {
+    const std::vector<float>& table = kernel();
+    // narrower than the input band when decimating, so that nothing folds back
+    const double scale = passband * std::min(1., 1. / mStep);
+    const double halfWidth = numZeroCrossings / scale;
+    const double phaseStep = scale * numPhases;
+
+    for (int n = mFirst; n < mLast; ++n)
+    {
+      if (shouldExit())
+      {
+        return jobHasFinished;
+      }
+
+      const double t = n * mStep;
+      const int first = std::max(0, static_cast<int>(ceil(t - halfWidth)));
+      const int last = std::min(mNumInput - 1, static_cast<int>(floor(t + halfWidth)));
+
+      // the kernel position runs from the first input sample down through zero
+      double phase = (t - first) * phaseStep;
+      double sum = 0;
+      for (int k = first; k <= last; ++k, phase -= phaseStep)
+      {
+        const double position = std::min(fabs(phase), numZeroCrossings * numPhases + 0.);
+        const int index = static_cast<int>(position);
+        const double fraction = position - index;
+        const float a = table[static_cast<std::size_t>(index)];
+        const float b = table[static_cast<std::size_t>(index + 1)];
+        sum += mInput[k] * (a + fraction * (b - a));
+      }
+      mOutput[n] = static_cast<float>(sum * scale);
+    }
+    return jobHasFinished;
+  }
+
+private:
+  const float* mInput;
+  int mNumInput;
+  float* mOutput;
+  int mFirst;
+  int mLast;
+  double mStep;
+};
+
+} // namespace
+
+bool resample(const AudioBuffer<float>& input,
+              const double inputRate,
+              const double outputRate,
+              AudioBuffer<float>& output,
+              const LoadProgress& progress)
+{
+  const double step = inputRate / outputRate;
+  const int numOutput = static_cast<int>(ceil(input.getNumSamples() / step));
+  output.setSize(input.getNumChannels(), numOutput);
+
+  std::vector<std::unique_ptr<ThreadPoolJob>> jobs;
+  for (int channel = 0; channel < input.getNumChannels(); ++channel)
+  {
+    for (int first = 0; first < numOutput; first += segmentSize)
+    {
+      jobs.emplace_back(new ResampleJob(
+        input.getReadPointer(channel), input.getNumSamples(),
+        output.getWritePointer(channel), first, std::min(first + segmentSize, numOutput),
+        step));
+    }
+  }
+  return runJobs(jobs, progress);
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,41 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SampleSource.h"
+#include "Warnings.h"
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Converts the buffer from inputRate to outputRate with a Kaiser windowed sinc, looked
+// up from a table of phases. Segments of the output are converted in parallel on the
+// shared worker pool, the calling thread only waits for them. Returns false if progress
+// asked to stop.
+bool resample(const AudioBuffer<float>& input,
+              double inputRate,
+              double outputRate,
+              AudioBuffer<float>& output,
+              const LoadProgress& progress = nullptr);
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,458 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SampleSource.h"
+#include "Resampler.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <climits>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+SampleSource::ScopedAccess::ScopedAccess(SampleSource* source)
+  : mSource(nullptr)
+{
+  reset(source);
+}
+
+SampleSource::ScopedAccess::~ScopedAccess()
+{
+  reset(nullptr);
+}
+
+void SampleSource::ScopedAccess::reset(SampleSource* source)
+{
+  if (mSource)
+  {
+    mSource->endAccess();
+  }
+  mSource = source;
+  if (mSource)
+  {
+    mSource->beginAccess();
+  }
+}
+
+SampleSource::SampleSource()
+  : mHasFileHash(false)
+{
+}
+
+SampleSource::~SampleSource()
+{
+}
+
+const AudioBuffer<float>* SampleSource::getBuffer() const
+{
+  return nullptr;
+}
+
+File SampleSource::getFile() const
+{
+  return File();
+}
+
+const PeakCache* SampleSource::getPeaks() const
+{
+  return mPeaks.get();
+}
+
+void SampleSource::setPeaks(std::unique_ptr<PeakCache> peaks)
+{
+  mPeaks = std::move(peaks);
+}
+
+String SampleSource::getFileHash() const
+{
+  std::lock_guard<std::mutex> lock(mFileHashMutex);
+  if (!mHasFileHash)
+  {
+    const File file = getFile();
+    mFileHash = file != File() ? MD5(file).toHexString() : String();
+    mHasFileHash = true;
+  }
+  return mFileHash;
+}
+
+void SampleSource::setFileHash(const String& hash)
+{
+  std::lock_guard<std::mutex> lock(mFileHashMutex);
+  mFileHash = hash;
+  mHasFileHash = true;
+}
+
+void SampleSource::prefetch(int64)
+{
+}
+
+void SampleSource::beginAccess()
+{
+}
+
+void SampleSource::endAccess()
+{
+}
+
+MemorySource::MemorySource(AudioBuffer<float> buffer,
+                           const double sampleRate,
+                           const File& file)
+  : mBuffer(std::move(buffer))
+  , mSampleRate(sampleRate)
+  , mFile(file)
+{
+}
+
+int MemorySource::getNumChannels() const
+{
+  return mBuffer.getNumChannels();
+}
+
+int64 MemorySource::getNumFrames() const
+{
+  return mBuffer.getNumSamples();
+}
+
+double MemorySource::getSampleRate() const
+{
+  return mSampleRate;
+}
+
+bool MemorySource::isStreaming() const
+{
+  return false;
+}
+
+const AudioBuffer<float>* MemorySource::getBuffer() const
+{
+  return &mBuffer;
+}
+
+File MemorySource::getFile() const
+{
+  return mFile;
+}
+
+bool MemorySource::getSpan(int64, int64, Span& span)
+{
+  span = {mBuffer.getArrayOfReadPointers(), 0};
+  return true;
+}
+
+StreamingSource::Slot::Slot(const int numChannels)
+  : data(numChannels, pageSize + pageOverlap)
+  , page(absent)
+  , lastUse(0)
+{
+}
+
+StreamingSource::StreamingSource(AudioFormatReader* reader, const File& file)
+  : Thread("breakov streaming")
+  , mReader(reader)
+  , mFile(file)
+  , mNumPages(reader->lengthInSamples / pageSize + 1)
+  , mPages(new std::atomic<int>[static_cast<std::size_t>(mNumPages)])
+  , mEpoch(0)
+  , mRequestFifo(maxNumRequests)
+{
+  for (int64 page = 0; page < mNumPages; ++page)
+  {
+    mPages[static_cast<std::size_t>(page)].store(absent);
+  }
+  for (int slot = 0; slot < numSlots; ++slot)
+  {
+    mSlots.emplace_back(new Slot(static_cast<int>(reader->numChannels)));
+  }
+  startThread();
+}
+
+StreamingSource::~StreamingSource()
+{
+  stopThread(1000);
+}
+
+int StreamingSource::getNumChannels() const
+{
+  return static_cast<int>(mReader->numChannels);
+}
+
+int64 StreamingSource::getNumFrames() const
+{
+  return mReader->lengthInSamples;
+}
+
+double StreamingSource::getSampleRate() const
+{
+  return mReader->sampleRate;
+}
+
+bool StreamingSource::isStreaming() const
+{
+  return true;
+}
+
+File StreamingSource::getFile() const
+{
+  return mFile;
+}
+
+bool StreamingSource::getSpan(const int64 first, const int64 last, Span& span)
+{
+  const int64 page = first / pageSize;
+  if (last >= (page + 1) * pageSize + pageOverlap)
+  {
+    request(page);
+    request(last / pageSize);
+    return false;
+  }
+
+  const int slot = mPages[static_cast<std::size_t>(page)].load();
+  if (slot < 0)
+  {
+    request(page);
+    return false;
+  }
+
+  Slot& s = *mSlots[static_cast<std::size_t>(slot)];
+  s.lastUse.store(mEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  span = {s.data.getArrayOfReadPointers(), page * pageSize};
+  return true;
+}
+
+void StreamingSource::prefetch(const int64 frame)
+{
+  const int64 page = jlimit<int64>(0, mNumPages - 1, frame / pageSize);
+  const int slot = mPages[static_cast<std::size_t>(page)].load();
+  if (slot >= 0)
+  {
+    mSlots[static_cast<std::size_t>(slot)]->lastUse.store(
+      mEpoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  else
+  {
+    request(page);
+  }
+}
+
+// The epoch is odd while the audio thread reads. Slots are only reused after the audio
+// thread has left the block in which it might have looked them up.
+void StreamingSource::beginAccess()
+{
+  mEpoch.fetch_add(1);
+}
+
+void StreamingSource::endAccess()
+{
+  mEpoch.fetch_add(1);
+}
+
+void StreamingSource::request(const int64 page)
+{
+  std::atomic<int>& state = mPages[static_cast<std::size_t>(page)];
+  int expected = absent;
+  if (!state.compare_exchange_strong(expected, requested))
+  {
+    return;
+  }
+
+  int start1, size1, start2, size2;
+  mRequestFifo.prepareToWrite(1, start1, size1, start2, size2);
+  if (size1 > 0)
+  {
+    mRequests[static_cast<std::size_t>(start1)] = page;
+    mRequestFifo.finishedWrite(1);
+  }
+  else
+  {
+    state.store(absent);
+  }
+}
+
+void StreamingSource::run()
+{
+  while (!threadShouldExit())
+  {
+    int start1, size1, start2, size2;
+    const int numRequests = mRequestFifo.getNumReady();
+    mRequestFifo.prepareToRead(numRequests, start1, size1, start2, size2);
+    for (int i = 0; i < size1; ++i)
+    {
+      load(mRequests[static_cast<std::size_t>(start1 + i)]);
+    }
+    for (int i = 0; i < size2; ++i)
+    {
+      load(mRequests[static_cast<std::size_t>(start2 + i)]);
+    }
+    mRequestFifo.finishedRead(size1 + size2);
+
+    wait(2);
+  }
+}
+
+void StreamingSource::load(const int64 page)
+{
+  const int slot = takeSlot();
+  Slot& s = *mSlots[static_cast<std::size_t>(slot)];
+  const int64 start = page * pageSize;
+  const int numFrames = static_cast<int>(
+    std::min<int64>(pageSize + pageOverlap, mReader->lengthInSamples - start));
+  s.data.clear();
+  mReader->read(&s.data, 0, numFrames, start, true, true);
+  s.page = page;
+  s.lastUse.store(mEpoch.load());
+  mPages[static_cast<std::size_t>(page)].store(slot, std::memory_order_release);
+}
+
+// an unused slot, or the least recently used one after unpublishing its page
+int StreamingSource::takeSlot()
+{
+  const uint32 epoch = mEpoch.load();
+  int oldest = 0;
+  uint32 oldestAge = 0;
+  for (int slot = 0; slot < numSlots; ++slot)
+  {
+    const Slot& s = *mSlots[static_cast<std::size_t>(slot)];
+    if (s.page == absent)
+    {
+      return slot;
+    }
+    const uint32 age = epoch - s.lastUse.load(std::memory_order_relaxed);
+    if (age >= oldestAge)
+    {
+      oldest = slot;
+      oldestAge = age;
+    }
+  }
+
+  Slot& s = *mSlots[static_cast<std::size_t>(oldest)];
+  mPages[static_cast<std::size_t>(s.page)].store(absent);
+  s.page = absent;
+  waitForReaders();
+  return oldest;
+}
+
+void StreamingSource::waitForReaders()
+{
+  const uint32 epoch = mEpoch.load();
+  if (epoch & 1)
+  {
+    while (mEpoch.load() == epoch && !threadShouldExit())
+    {
+      Thread::yield();
+    }
+  }
+}
+
+std::shared_ptr<SampleSource> makeMemorySource(AudioBuffer<float> buffer,
+                                               const double sampleRate,
+                                               const File& file)
+{
+  std::unique_ptr<PeakCache> peaks(
+    new PeakCache(buffer.getNumChannels(), buffer.getNumSamples()));
+  peaks->add(buffer, buffer.getNumSamples());
+  peaks->finish();
+
+  auto source = std::make_shared<MemorySource>(std::move(buffer), sampleRate, file);
+  source->setPeaks(std::move(peaks));
+  return source;
+}
+
+std::shared_ptr<SampleSource> openSampleSource(const File& file,
+                                               const LoadProgress& progress)
+{
+  AudioFormatManager formatManager;
+  formatManager.registerBasicFormats();
+  ScopedPointer<AudioFormatReader> reader(formatManager.createReaderFor(file));
+  if (!reader || reader->lengthInSamples <= 0)
+  {
+    return nullptr;
+  }
+
+  const int numChannels = static_cast<int>(reader->numChannels);
+  const int64 numFrames = reader->lengthInSamples;
+  const int chunkSize = 1 << 16;
+
+  if (numFrames * numChannels <= maxInMemorySamples && numFrames <= INT_MAX)
+  {
+    AudioBuffer<float> buffer(numChannels, static_cast<int>(numFrames));
+    for (int start = 0; start < buffer.getNumSamples(); start += chunkSize)
+    {
+      if (progress && !progress(static_cast<double>(start) / buffer.getNumSamples()))
+      {
+        return nullptr;
+      }
+      const int length = std::min(chunkSize, buffer.getNumSamples() - start);
+      reader->read(&buffer, start, length, start, true, true);
+    }
+
+    return makeMemorySource(std::move(buffer), reader->sampleRate, file);
+  }
+
+  AudioFormat* format = formatManager.findFormatForFileExtension(file.getFileExtension());
+  if (format)
+  {
+    ScopedPointer<MemoryMappedAudioFormatReader> mapped(
+      format->createMemoryMappedReader(file));
+    if (mapped && mapped->mapEntireFile())
+    {
+      reader = mapped.release();
+    }
+  }
+
+  std::unique_ptr<PeakCache> peaks(new PeakCache(numChannels, numFrames));
+  AudioBuffer<float> chunk(numChannels, chunkSize);
+  for (int64 start = 0; start < numFrames; start += chunkSize)
+  {
+    if (progress && !progress(static_cast<double>(start) / numFrames))
+    {
+      return nullptr;
+    }
+    const int length = static_cast<int>(std::min<int64>(chunkSize, numFrames - start));
+    reader->read(&chunk, 0, length, start, true, true);
+    peaks->add(chunk, length);
+  }
+  peaks->finish();
+
+  auto source = std::make_shared<StreamingSource>(reader.release(), file);
+  source->setPeaks(std::move(peaks));
+  return source;
+}
+
+std::shared_ptr<SampleSource> convertSampleRate(
+  const std::shared_ptr<SampleSource>& source,
+  const double sampleRate,
+  const LoadProgress& progress)
+{
+  const AudioBuffer<float>* buffer = source->getBuffer();
+  if (!buffer || sampleRate <= 0 || sampleRate == source->getSampleRate())
+  {
+    return source;
+  }
+
+  AudioBuffer<float> converted;
+  if (!resample(*buffer, source->getSampleRate(), sampleRate, converted, progress))
+  {
+    return nullptr;
+  }
+  return std::make_shared<MemorySource>(std::move(converted), sampleRate);
+}
+
+} // namespace breakov
+
+POP_WARNINGS
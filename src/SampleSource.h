@@ -0,0 +1,199 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "PeakCache.h"
+#include "Warnings.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+// files with more samples (frames times channels) than this are streamed from disk
+const static int64 maxInMemorySamples = 1 << 26;
+
+// Called with the fraction of a file decoded so far. Returning false abandons it.
+using LoadProgress = std::function<bool(double)>;
+
+// The frames of a sound file. The audio thread brackets its reads with a ScopedAccess.
+class SampleSource
+{
+public:
+  // channels[c][frame - first] is valid for the requested frames
+  struct Span
+  {
+    const float* const* channels;
+    int64 first;
+  };
+
+  class ScopedAccess
+  {
+  public:
+    ScopedAccess(SampleSource* source);
+    ~ScopedAccess();
+
+    // ends the access to the current source and starts it on the next one
+    void reset(SampleSource* source);
+
+  private:
+    SampleSource* mSource;
+  };
+
+  SampleSource();
+  virtual ~SampleSource();
+
+  virtual int getNumChannels() const = 0;
+  virtual int64 getNumFrames() const = 0;
+  virtual double getSampleRate() const = 0;
+  virtual bool isStreaming() const = 0;
+
+  // the decoded audio, if the source holds all of it in memory
+  virtual const AudioBuffer<float>* getBuffer() const;
+  virtual File getFile() const;
+
+  // overview for painting, built while loading
+  const PeakCache* getPeaks() const;
+  void setPeaks(std::unique_ptr<PeakCache> peaks);
+
+  // MD5 of the file's contents, empty if the source doesn't come from a file. Reading
+  // the whole file takes a while, so it is only taken the first time it is asked for.
+  String getFileHash() const;
+  void setFileHash(const String& hash);
+
+  // Realtime. Frames first to last (inclusive) without blocking. Fails and schedules
+  // loading if they are not available yet.
+  virtual bool getSpan(int64 first, int64 last, Span& span) = 0;
+
+  // Realtime. The frame is about to be read.
+  virtual void prefetch(int64 frame);
+
+private:
+  virtual void beginAccess();
+  virtual void endAccess();
+
+  std::unique_ptr<const PeakCache> mPeaks;
+  mutable std::mutex mFileHashMutex;
+  mutable String mFileHash;
+  mutable bool mHasFileHash;
+};
+
+class MemorySource : public SampleSource
+{
+public:
+  MemorySource(AudioBuffer<float> buffer, double sampleRate, const File& file = File());
+
+  int getNumChannels() const override;
+  int64 getNumFrames() const override;
+  double getSampleRate() const override;
+  bool isStreaming() const override;
+  const AudioBuffer<float>* getBuffer() const override;
+  File getFile() const override;
+  bool getSpan(int64 first, int64 last, Span& span) override;
+
+private:
+  AudioBuffer<float> mBuffer;
+  double mSampleRate;
+  File mFile;
+};
+
+// Reads the file in pages on a background thread into a fixed number of cache slots.
+// Pages that are not resident are requested by the audio thread and read as silence
+// until they arrive.
+class StreamingSource : public SampleSource, private Thread
+{
+public:
+  const static int pageSize = 1 << 15;
+  // frames a slot holds past the end of its page, so that the frames an interpolation
+  // reads around a position never straddle two slots
+  const static int pageOverlap = 8;
+  const static int numSlots = 128;
+
+  StreamingSource(AudioFormatReader* reader, const File& file);
+  ~StreamingSource();
+
+  int getNumChannels() const override;
+  int64 getNumFrames() const override;
+  double getSampleRate() const override;
+  bool isStreaming() const override;
+  File getFile() const override;
+  bool getSpan(int64 first, int64 last, Span& span) override;
+  void prefetch(int64 frame) override;
+
+private:
+  const static int absent = -1;
+  const static int requested = -2;
+  const static int maxNumRequests = 256;
+
+  struct Slot
+  {
+    Slot(int numChannels);
+
+    // a page and the overlap into the next one
+    AudioBuffer<float> data;
+    int64 page;
+    std::atomic<uint32> lastUse;
+  };
+
+  void beginAccess() override;
+  void endAccess() override;
+  void run() override;
+  void request(int64 page);
+  void load(int64 page);
+  int takeSlot();
+  void waitForReaders();
+
+  ScopedPointer<AudioFormatReader> mReader;
+  File mFile;
+  int64 mNumPages;
+  std::unique_ptr<std::atomic<int>[]> mPages;
+  std::vector<std::unique_ptr<Slot>> mSlots;
+  std::atomic<uint32> mEpoch;
+  AbstractFifo mRequestFifo;
+  std::array<int64, maxNumRequests> mRequests;
+};
+
+// A source for audio decoded already, such as audio restored from the plug-in state,
+// with its peaks.
+std::shared_ptr<SampleSource> makeMemorySource(AudioBuffer<float> buffer,
+                                               double sampleRate,
+                                               const File& file = File());
+
+// Decodes small files into memory and streams large ones, memory mapped if the format
+// allows it. Either way the whole file is scanned once for its peaks. Returns nullptr if
+// the file can't be read or loading was abandoned.
+std::shared_ptr<SampleSource> openSampleSource(const File& file,
+                                               const LoadProgress& progress = nullptr);
+
+// The source resampled to the sample rate, or the source itself if it is at that rate
+// already, streamed, or the rate isn't known yet. Returns nullptr if the conversion was
+// abandoned.
+std::shared_ptr<SampleSource> convertSampleRate(
+  const std::shared_ptr<SampleSource>& source,
+  double sampleRate,
+  const LoadProgress& progress = nullptr);
+
+} // namespace breakov
+
+POP_WARNINGS
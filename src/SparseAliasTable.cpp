@@ -0,0 +1,102 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "SparseAliasTable.h"
+#include "AliasTable.h"
+#include "Warnings.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+SparseAliasTable::SparseAliasTable()
+  : mNumColumns(1)
+{
+}
+
+void SparseAliasTable::reset(const int numColumns)
+{
+  mNumColumns = std::max(1, numColumns);
+  mRowStarts.assign(1, 0);
+  mColumns.clear();
+  mProb.clear();
+  mAlias.clear();
+}
+
+void SparseAliasTable::addRow(const int* columns, const float* weights, const int size)
+{
+  double sum = 0;
+  for (int i = 0; i < size; ++i)
+  {
+    if (weights[i] > 0)
+    {
+      sum += static_cast<double>(weights[i]);
+    }
+  }
+  addRow(columns, weights, size, sum);
+}
+
+void SparseAliasTable::addRow(const int* columns,
+                              const float* weights,
+                              const int size,
+                              const double sum)
+{
+  const std::size_t first = mColumns.size();
+  for (int i = 0; i < size; ++i)
+  {
+    if (weights[i] > 0)
+    {
+      mColumns.push_back(columns[i]);
+      mScaled.push_back(static_cast<double>(weights[i]));
+    }
+  }
+
+  const int rowSize = static_cast<int>(mColumns.size() - first);
+  mProb.resize(mColumns.size());
+  mAlias.resize(mColumns.size());
+  mSmall.resize(static_cast<std::size_t>(rowSize));
+  mLarge.resize(static_cast<std::size_t>(rowSize));
+  for (double& scaled : mScaled)
+  {
+    scaled *= rowSize / sum;
+  }
+  if (rowSize > 0)
+  {
+    // aliases are relative to the start of the row
+    pairAliases(mScaled.data(), rowSize, mProb.data() + first, mAlias.data() + first,
+                mSmall.data(), mLarge.data());
+  }
+  mScaled.clear();
+  mRowStarts.push_back(static_cast<int>(mColumns.size()));
+}
+
+int SparseAliasTable::getNumRows() const
+{
+  return static_cast<int>(mRowStarts.size()) - 1;
+}
+
+int SparseAliasTable::getNumColumns() const
+{
+  return mNumColumns;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,85 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "Random.h"
+#include "Warnings.h"
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Alias tables for the rows of a sparse matrix, kept as compressed rows, so that memory
+// scales with the number of non-zero weights rather than rows times columns. Drawing from
+// a row is O(1) like AliasTable. A row without any weight draws uniformly from all
+// columns.
+class SparseAliasTable
+{
+public:
+  SparseAliasTable();
+
+  // starts over without any rows
+  void reset(int numColumns);
+  // Appends the next row. Weights need not be normalised, zero weights are left out.
+  void addRow(const int* columns, const float* weights, int size);
+  // with the sum of the weights known already
+  void addRow(const int* columns, const float* weights, int size, double sum);
+
+  template <typename Generator>
+  int operator()(int row, Generator& generator) const;
+
+  int getNumRows() const;
+  int getNumColumns() const;
+
+private:
+  int mNumColumns;
+  std::vector<int> mRowStarts;
+  std::vector<int> mColumns;
+  std::vector<float> mProb;
+  std::vector<int> mAlias;
+  // scratch space for building a row
+  std::vector<double> mScaled;
+  std::vector<int> mSmall;
+  std::vector<int> mLarge;
+};
+
+// Rows that weren't added, as after the number of slices grew, draw uniformly as well.
+template <typename Generator>
+int SparseAliasTable::operator()(const int row, Generator& generator) const
+{
+  const bool hasRow = row < getNumRows();
+  const int first = hasRow ? mRowStarts[static_cast<std::size_t>(row)] : 0;
+  const int last = hasRow ? mRowStarts[static_cast<std::size_t>(row + 1)] : 0;
+  if (first == last)
+  {
+    return drawBelow(generator, mNumColumns);
+  }
+
+  const std::size_t i =
+    static_cast<std::size_t>(first + drawBelow(generator, last - first));
+  const int drawn = drawUnit(generator) < mProb[i] ? static_cast<int>(i)
+                                                   : first + mAlias[i];
+  return mColumns[static_cast<std::size_t>(drawn)];
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,201 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "SparseChain.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <cmath>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+// like the warp parameters, all slices play unwarped
+std::array<float, numWarps> defaultWarps()
+{
+  std::array<float, numWarps> warps;
+  warps.fill(0.f);
+  warps[0] = 1.f;
+  return warps;
+}
+
+bool byTarget(const SparseChain::Transition& transition, const int target)
+{
+  return transition.target < target;
+}
+
+} // namespace
+
+bool canHoldTransitions(InputStream& stream, const int size)
+{
+  return size >= 0 && size <= stream.getNumBytesRemaining() / 5;
+}
+
+SparseChain::SparseChain(const int numSlices)
+  : mFollow(static_cast<std::size_t>(numSlices))
+  , mWarp(static_cast<std::size_t>(numSlices), defaultWarps())
+{
+}
+
+int SparseChain::getNumSlices() const
+{
+  return static_cast<int>(mFollow.size());
+}
+
+float SparseChain::getFollow(const int slice, const int target) const
+{
+  const std::vector<Transition>& row = mFollow[static_cast<std::size_t>(slice)];
+  auto it = std::lower_bound(row.begin(), row.end(), target, byTarget);
+  return it != row.end() && it->target == target ? it->value : 0.f;
+}
+
+void SparseChain::setFollow(const int slice, const int target, const float value)
+{
+  std::vector<Transition>& row = mFollow[static_cast<std::size_t>(slice)];
+  auto it = std::lower_bound(row.begin(), row.end(), target, byTarget);
+  const bool exists = it != row.end() && it->target == target;
+  if (value <= 0)
+  {
+    if (exists)
+    {
+      row.erase(it);
+    }
+  }
+  else if (exists)
+  {
+    it->value = value;
+  }
+  else
+  {
+    row.insert(it, {target, value});
+  }
+}
+
+void SparseChain::clearFollow(const int slice)
+{
+  mFollow[static_cast<std::size_t>(slice)].clear();
+}
+
+const std::vector<SparseChain::Transition>& SparseChain::getFollowRow(
+  const int slice) const
+{
+  return mFollow[static_cast<std::size_t>(slice)];
+}
+
+float SparseChain::getWarp(const int slice, const int warp) const
+{
+  return mWarp[static_cast<std::size_t>(slice)][static_cast<std::size_t>(warp)];
+}
+
+void SparseChain::setWarp(const int slice, const int warp, const float value)
+{
+  mWarp[static_cast<std::size_t>(slice)][static_cast<std::size_t>(warp)] = value;
+}
+
+// The follow rows that have transitions, each as its slice, its size and the target and
+// value of every transition, then the warp rows that aren't the default.
+void SparseChain::write(OutputStream& stream) const
+{
+  const int numFollowRows = static_cast<int>(
+    std::count_if(mFollow.begin(), mFollow.end(),
+                  [](const std::vector<Transition>& row) { return !row.empty(); }));
+  stream.writeCompressedInt(numFollowRows);
+  for (int slice = 0; slice < getNumSlices(); ++slice)
+  {
+    const std::vector<Transition>& row = getFollowRow(slice);
+    if (!row.empty())
+    {
+      stream.writeCompressedInt(slice);
+      stream.writeCompressedInt(static_cast<int>(row.size()));
+      for (const Transition& transition : row)
+      {
+        stream.writeCompressedInt(transition.target);
+        stream.writeFloat(transition.value);
+      }
+    }
+  }
+
+  const std::array<float, numWarps> defaults = defaultWarps();
+  const int numWarpRows = static_cast<int>(std::count_if(
+    mWarp.begin(), mWarp.end(),
+    [&defaults](const std::array<float, numWarps>& row) { return row != defaults; }));
+  stream.writeCompressedInt(numWarpRows);
+  for (int slice = 0; slice < getNumSlices(); ++slice)
+  {
+    const std::array<float, numWarps>& row = mWarp[static_cast<std::size_t>(slice)];
+    if (row != defaults)
+    {
+      stream.writeCompressedInt(slice);
+      for (const float value : row)
+      {
+        stream.writeFloat(value);
+      }
+    }
+  }
+}
+
+void SparseChain::read(InputStream& stream)
+{
+  for (int slice = 0; slice < getNumSlices(); ++slice)
+  {
+    clearFollow(slice);
+    mWarp[static_cast<std::size_t>(slice)] = defaultWarps();
+  }
+
+  const int numFollowRows = stream.readCompressedInt();
+  for (int i = 0; i < numFollowRows && !stream.isExhausted(); ++i)
+  {
+    const int slice = stream.readCompressedInt();
+    const int size = stream.readCompressedInt();
+    if (!canHoldTransitions(stream, size))
+    {
+      return;
+    }
+    for (int j = 0; j < size && !stream.isExhausted(); ++j)
+    {
+      const int target = stream.readCompressedInt();
+      const float value = stream.readFloat();
+      if (isPositiveAndBelow(slice, getNumSlices())
+          && isPositiveAndBelow(target, getNumSlices()) && std::isfinite(value))
+      {
+        setFollow(slice, target, value);
+      }
+    }
+  }
+
+  const int numWarpRows = stream.readCompressedInt();
+  for (int i = 0; i < numWarpRows && !stream.isExhausted(); ++i)
+  {
+    const int slice = stream.readCompressedInt();
+    for (int warp = 0; warp < numWarps; ++warp)
+    {
+      const float value = stream.readFloat();
+      if (isPositiveAndBelow(slice, getNumSlices()) && std::isfinite(value))
+      {
+        setWarp(slice, warp, value);
+      }
+    }
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
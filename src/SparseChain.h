@@ -0,0 +1,73 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Warnings.h"
+#include "Warps.h"
+#include <array>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Follow and warp probabilities for chains with more slices than have parameters. A
+// follow row keeps only its non-zero transitions, sorted by target, so that memory
+// scales with the transitions rather than the square of the slices; an empty row follows
+// uniformly. Values are normalised like the parameters they stand in for.
+class SparseChain
+{
+public:
+  struct Transition
+  {
+    int target;
+    float value;
+  };
+
+  explicit SparseChain(int numSlices);
+
+  int getNumSlices() const;
+
+  float getFollow(int slice, int target) const;
+  // a value of 0 removes the transition
+  void setFollow(int slice, int target, float value);
+  void clearFollow(int slice);
+  const std::vector<Transition>& getFollowRow(int slice) const;
+
+  float getWarp(int slice, int warp) const;
+  void setWarp(int slice, int warp, float value);
+
+  // only the rows that differ from the defaults
+  void write(OutputStream& stream) const;
+  void read(InputStream& stream);
+
+private:
+  std::vector<std::vector<Transition>> mFollow;
+  std::vector<std::array<float, numWarps>> mWarp;
+};
+
+// whether what is left of a stream can hold a row of size transitions as they are
+// written, a compressed int and a float each
+bool canHoldTransitions(InputStream& stream, int size);
+
+} // namespace breakov
+
+POP_WARNINGS
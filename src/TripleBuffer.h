@@ -0,0 +1,84 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Warnings.h"
+#include <array>
+#include <atomic>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Wait-free handoff of a value from one writer thread to one reader thread. The writer
+// fills back() and publishes it, the reader picks up the latest published value in
+// read(). Neither side allocates or blocks.
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer();
+
+  T& back();
+  void publish();
+
+  const T& read();
+
+private:
+  const static int dirty = 4;
+
+  std::array<T, 3> mBuffers;
+  int mBack;
+  std::atomic<int> mMiddle;
+  int mFront;
+};
+
+template <typename T>
+TripleBuffer<T>::TripleBuffer()
+  : mBack(0)
+  , mMiddle(1)
+  , mFront(2)
+{
+}
+
+template <typename T>
+T& TripleBuffer<T>::back()
+{
+  return mBuffers[static_cast<std::size_t>(mBack)];
+}
+
+template <typename T>
+void TripleBuffer<T>::publish()
+{
+  mBack = mMiddle.exchange(mBack | dirty, std::memory_order_acq_rel) & ~dirty;
+}
+
+template <typename T>
+const T& TripleBuffer<T>::read()
+{
+  if (mMiddle.load(std::memory_order_relaxed) & dirty)
+  {
+    mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & ~dirty;
+  }
+  return mBuffers[static_cast<std::size_t>(mFront)];
+}
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,113 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Warnings.h"
+#include <array>
+#include <cmath>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+const static int numWarps = 16;
+
+// the last warp plays nothing
+const static int silentWarp = numWarps - 1;
+
+using Warp = double (*)(double);
+
+// Maps the progress through a slice (0..1) to the read position inside the slice (0..1).
+template <int W>
+double warp(double x);
+
+namespace detail
+{
+inline double wrap(const double x)
+{
+  return x - std::floor(x);
+}
+
+inline double triangle(const double x)
+{
+  return x < 0.5 ? 2 * x : 2 - (2 * x);
+}
+} // namespace detail
+
+// clang-format off
+template <> inline double warp<0>(const double x) { return x; }
+template <> inline double warp<1>(const double x) { return 1 - x; }
+template <> inline double warp<2>(const double x) { return x * x * x; }
+template <> inline double warp<3>(const double x) { return 1 - (x * x * x); }
+template <> inline double warp<4>(const double x) { return std::sin(x * M_PI); }
+template <> inline double warp<5>(const double x) { return 1 - std::sin(x * M_PI); }
+template <> inline double warp<6>(const double x) { return x + (x * std::sin(x * 2 * M_PI)); }
+template <> inline double warp<7>(const double x) { return detail::triangle(x); }
+template <> inline double warp<8>(const double x) { return 1 - detail::triangle(x); }
+template <> inline double warp<9>(const double x) { return detail::wrap(x * 2.); }
+template <> inline double warp<10>(const double x) { return 1 - detail::wrap(x * 2.); }
+template <> inline double warp<11>(const double x) { return detail::wrap(x * 3.); }
+template <> inline double warp<12>(const double x) { return 1 - detail::wrap(x * 3.); }
+template <> inline double warp<13>(const double x) { return detail::wrap(x * 4.); }
+template <> inline double warp<14>(const double x) { return 1 - detail::wrap(x * 4.); }
+template <> inline double warp<15>(const double) { return 0; }
+// clang-format on
+
+// Writes the read positions (in samples) of numSamples consecutive output samples,
+// starting at progress and advancing by increment per sample.
+using WarpKernel = void (*)(double progress,
+                            double increment,
+                            double length,
+                            int numSamples,
+                            double* positions);
+
+template <int W>
+void warpPositions(const double progress,
+                   const double increment,
+                   const double length,
+                   const int numSamples,
+                   double* positions)
+{
+  for (int i = 0; i < numSamples; ++i)
+  {
+    positions[i] = warp<W>(progress + i * increment) * length;
+  }
+}
+
+inline const std::array<Warp, numWarps>& warps()
+{
+  static const std::array<Warp, numWarps> warps{
+    {&warp<0>, &warp<1>, &warp<2>, &warp<3>, &warp<4>, &warp<5>, &warp<6>, &warp<7>,
+     &warp<8>, &warp<9>, &warp<10>, &warp<11>, &warp<12>, &warp<13>, &warp<14>,
+     &warp<15>}};
+  return warps;
+}
+
+inline const std::array<WarpKernel, numWarps>& warpKernels()
+{
+  static const std::array<WarpKernel, numWarps> kernels{
+    {&warpPositions<0>, &warpPositions<1>, &warpPositions<2>, &warpPositions<3>,
+     &warpPositions<4>, &warpPositions<5>, &warpPositions<6>, &warpPositions<7>,
+     &warpPositions<8>, &warpPositions<9>, &warpPositions<10>, &warpPositions<11>,
+     &warpPositions<12>, &warpPositions<13>, &warpPositions<14>, &warpPositions<15>}};
+  return kernels;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
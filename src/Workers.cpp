@@ -0,0 +1,68 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Workers.h"
+#include "Warnings.h"
+#include <algorithm>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+ThreadPool& workerPool()
+{
+  static ThreadPool pool(std::max(1, SystemStats::getNumCpus() - 1));
+  return pool;
+}
+
+bool runJobs(const std::vector<std::unique_ptr<ThreadPoolJob>>& jobs,
+             const LoadProgress& progress)
+{
+  ThreadPool& pool = workerPool();
+  for (const auto& job : jobs)
+  {
+    pool.addJob(job.get(), false);
+  }
+
+  // the pool lets go of a job once it has finished, other callers' jobs don't count
+  for (;;)
+  {
+    const auto numDone = std::count_if(
+      jobs.begin(), jobs.end(), [&pool](const std::unique_ptr<ThreadPoolJob>& job) {
+        return !pool.contains(job.get());
+      });
+    if (numDone == static_cast<std::ptrdiff_t>(jobs.size()))
+    {
+      return true;
+    }
+    if (progress
+        && !progress(static_cast<double>(numDone) / static_cast<double>(jobs.size())))
+    {
+      for (const auto& job : jobs)
+      {
+        pool.removeJob(job.get(), true, 10000);
+      }
+      return false;
+    }
+    Thread::sleep(1);
+  }
+}
+
+} // namespace breakov
+
+POP_WARNINGS
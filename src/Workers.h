@@ -0,0 +1,43 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SampleSource.h"
+#include "Warnings.h"
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// Worker threads shared by everything that prepares loaded audio, one per core but the
+// caller's. Created on first use and kept for the life of the process, so that loading
+// a file doesn't start and stop threads of its own.
+ThreadPool& workerPool();
+
+// Runs the jobs on the worker pool and waits for them, reporting the fraction done.
+// Returns false, once the jobs that had started have stopped, if progress asked to stop.
+bool runJobs(const std::vector<std::unique_ptr<ThreadPoolJob>>& jobs,
+             const LoadProgress& progress);
+
+} // namespace breakov
+
+POP_WARNINGS
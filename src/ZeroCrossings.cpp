@@ -0,0 +1,205 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ZeroCrossings.h"
+#include "Warnings.h"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#if JUCE_INTEL
+#include <emmintrin.h>
+#endif
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+namespace
+{
+const int wordBits = 64;
+
+int lowestBit(const uint64 word)
+{
+  const uint32 low = static_cast<uint32>(word);
+  const uint32 bits = low != 0 ? low : static_cast<uint32>(word >> 32);
+  return (low != 0 ? 0 : 32) + countNumberOfBits((bits & (0u - bits)) - 1);
+}
+
+int highestBit(const uint64 word)
+{
+  const uint32 high = static_cast<uint32>(word >> 32);
+  return high != 0 ? 32 + findHighestSetBit(high)
+                   : findHighestSetBit(static_cast<uint32>(word));
+}
+
+// The sign bits of frames first to first + 64 of the channel sum, of which sum holds
+// room for 64 values.
+uint64 signBits(const AudioBuffer<float>& buffer, const int first, float* sum)
+{
+  const int numFrames = std::min(wordBits, buffer.getNumSamples() - first);
+  FloatVectorOperations::clear(sum, wordBits);
+  for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+  {
+    FloatVectorOperations::add(sum, buffer.getReadPointer(channel, first), numFrames);
+  }
+
+  uint64 signs = 0;
+#if JUCE_INTEL
+  for (int i = 0; i < wordBits; i += 4)
+  {
+    const uint64 mask = static_cast<uint64>(_mm_movemask_ps(_mm_loadu_ps(sum + i)));
+    signs |= mask << i;
+  }
+#else
+  for (int i = 0; i < wordBits; ++i)
+  {
+    signs |= static_cast<uint64>(sum[i] < 0) << i;
+  }
+#endif
+  return signs;
+}
+
+} // namespace
+
+// A frame crosses if its sign differs from the one of the frame before.
+ZeroCrossings::ZeroCrossings(const AudioBuffer<float>& buffer)
+  : mNumFrames(buffer.getNumSamples())
+  , mBits(static_cast<std::size_t>((mNumFrames + wordBits - 1) / wordBits))
+{
+  float sum[wordBits];
+  uint64 lastSign = 0;
+  for (std::size_t word = 0; word < mBits.size(); ++word)
+  {
+    const uint64 signs = signBits(buffer, static_cast<int>(word) * wordBits, sum);
+    mBits[word] = signs ^ ((signs << 1) | lastSign);
+    lastSign = signs >> (wordBits - 1);
+  }
+  if (!mBits.empty())
+  {
+    // the first frame has nothing to cross from, frames past the end aren't there
+    mBits.front() &= ~uint64(1);
+    const int numLast = static_cast<int>(mNumFrames - (mBits.size() - 1) * wordBits);
+    if (numLast < wordBits)
+    {
+      mBits.back() &= (uint64(1) << numLast) - 1;
+    }
+  }
+}
+
+int64 ZeroCrossings::nearest(const int64 frame, const int64 first, const int64 last) const
+{
+  const int64 after = frame <= last ? next(std::max(frame, first), last) : -1;
+  const int64 before = frame > first ? previous(std::min(frame - 1, last), first) : -1;
+  if (after < 0 || (before >= 0 && frame - before < after - frame))
+  {
+    return before;
+  }
+  return after;
+}
+
+// the first crossing from one frame up to another, or -1
+int64 ZeroCrossings::next(const int64 from, int64 last) const
+{
+  last = std::min(last, mNumFrames - 1);
+  if (from < 0 || from > last)
+  {
+    return -1;
+  }
+
+  std::size_t word = static_cast<std::size_t>(from / wordBits);
+  uint64 bits = mBits[word] & (~uint64(0) << (from % wordBits));
+  while (bits == 0)
+  {
+    if (static_cast<int64>(++word) * wordBits > last)
+    {
+      return -1;
+    }
+    bits = mBits[word];
+  }
+  const int64 crossing = static_cast<int64>(word) * wordBits + lowestBit(bits);
+  return crossing <= last ? crossing : -1;
+}
+
+// the last crossing from one frame down to another, or -1
+int64 ZeroCrossings::previous(int64 from, const int64 first) const
+{
+  from = std::min(from, mNumFrames - 1);
+  if (from < 0 || from < first)
+  {
+    return -1;
+  }
+
+  std::size_t word = static_cast<std::size_t>(from / wordBits);
+  uint64 bits = mBits[word] & (~uint64(0) >> (wordBits - 1 - from % wordBits));
+  while (bits == 0)
+  {
+    if (word == 0 || static_cast<int64>(word) * wordBits - 1 < first)
+    {
+      return -1;
+    }
+    bits = mBits[--word];
+  }
+  const int64 crossing = static_cast<int64>(word) * wordBits + highestBit(bits);
+  return crossing >= first ? crossing : -1;
+}
+
+std::shared_ptr<const ZeroCrossings> findZeroCrossings(const SampleSource& source)
+{
+  const AudioBuffer<float>* buffer = source.getBuffer();
+  return buffer ? std::make_shared<const ZeroCrossings>(*buffer) : nullptr;
+}
+
+int64 snapToQuiet(const AudioBuffer<float>& buffer,
+                  const ZeroCrossings& crossings,
+                  const int64 frame,
+                  const int64 first,
+                  const int64 last)
+{
+  const int64 crossing = crossings.nearest(frame, first, last);
+  if (crossing >= 0)
+  {
+    return crossing;
+  }
+
+  int64 quietest = frame;
+  float least = std::numeric_limits<float>::max();
+  for (int64 i = std::max<int64>(0, first);
+       i <= std::min<int64>(last, buffer.getNumSamples() - 1); ++i)
+  {
+    float energy = 0;
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+      const float sample = buffer.getSample(channel, static_cast<int>(i));
+      energy += sample * sample;
+    }
+    // ties go to the frame closest to the one asked for
+    if (energy < least
+        || (energy == least && std::abs(i - frame) < std::abs(quietest - frame)))
+    {
+      quietest = i;
+      least = energy;
+    }
+  }
+  return quietest;
+}
+
+} // namespace breakov
+
+POP_WARNINGS
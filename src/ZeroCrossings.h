@@ -0,0 +1,63 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SampleSource.h"
+#include "Warnings.h"
+#include <memory>
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+
+// A bit per frame, set where the channel sum changes sign. The crossing nearest to a
+// frame is found by looking at 64 frames at a time.
+class ZeroCrossings
+{
+public:
+  explicit ZeroCrossings(const AudioBuffer<float>& buffer);
+
+  // the crossing nearest to frame among frames first to last (inclusive), or -1
+  int64 nearest(int64 frame, int64 first, int64 last) const;
+
+private:
+  int64 next(int64 from, int64 last) const;
+  int64 previous(int64 from, int64 first) const;
+
+  int64 mNumFrames;
+  std::vector<uint64> mBits;
+};
+
+// nullptr for streamed sources
+std::shared_ptr<const ZeroCrossings> findZeroCrossings(const SampleSource& source);
+
+// The zero crossing nearest to frame among frames first to last (inclusive), or where
+// there is none, the frame of the least energy over all channels.
+int64 snapToQuiet(const AudioBuffer<float>& buffer,
+                  const ZeroCrossings& crossings,
+                  int64 frame,
+                  int64 first,
+                  int64 last);
+
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,258 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "OfflineHost.h"
+#include "../src/Warnings.h"
+#include <algorithm>
+#include <chrono>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+namespace tools
+{
+
+OfflinePlayHead::OfflinePlayHead(const double bpm,
+                                 const double ppq,
+                                 const bool playing,
+                                 const double sampleRate)
+  : mBpm(bpm)
+  , mPpq(ppq)
+  , mPlaying(playing)
+  , mSampleRate(sampleRate)
+  , mTimeInSamples(0)
+{
+}
+
+bool OfflinePlayHead::getCurrentPosition(CurrentPositionInfo& result)
+{
+  result.resetToDefault();
+  result.bpm = mBpm;
+  result.timeSigNumerator = beatsPerBar;
+  result.timeSigDenominator = 4;
+  result.timeInSamples = mTimeInSamples;
+  result.timeInSeconds = static_cast<double>(mTimeInSamples) / mSampleRate;
+  result.ppqPosition = mPpq;
+  result.ppqPositionOfLastBarStart = floor(mPpq / beatsPerBar) * beatsPerBar;
+  result.isPlaying = mPlaying;
+  return true;
+}
+
+void OfflinePlayHead::advance(const int numSamples)
+{
+  if (mPlaying)
+  {
+    mTimeInSamples += numSamples;
+    mPpq += static_cast<double>(numSamples) / mSampleRate * mBpm / 60.;
+  }
+}
+
+String option(const StringArray& args, const String& name, const String& fallback)
+{
+  const int index = args.indexOf(name);
+  return index >= 0 && index + 1 < args.size() ? args[index + 1] : fallback;
+}
+
+std::vector<MidiEvent> parseMidiScript(const String& script)
+{
+  std::vector<MidiEvent> events;
+  for (const String& entry : StringArray::fromTokens(script, ",", ""))
+  {
+    const StringArray fields = StringArray::fromTokens(entry.trim(), ":", "");
+    if (fields.size() == 3)
+    {
+      events.push_back({fields[0].getDoubleValue(), fields[1].getIntValue(),
+                        fields[2].equalsIgnoreCase("on")});
+    }
+  }
+  return events;
+}
+
+RenderSettings::RenderSettings()
+  : bpm(120)
+  , ppq(0)
+  , playing(true)
+  , sampleRate(48000)
+  , numChannels(2)
+  , numBars(8)
+  , blockSize(512)
+  , midi{{0, 60, true}}
+{
+}
+
+int64 numSamplesToRender(const RenderSettings& settings)
+{
+  const double beats = static_cast<double>(settings.numBars * beatsPerBar);
+  return static_cast<int64>(beats * 60. / settings.bpm * settings.sampleRate);
+}
+
+RenderResult render(Processor& processor, const RenderSettings& settings)
+{
+  const int64 totalSamples = numSamplesToRender(settings);
+  const double samplesPerBeat = settings.sampleRate * 60. / settings.bpm;
+
+  OfflinePlayHead playHead(settings.bpm, settings.ppq, settings.playing,
+                           settings.sampleRate);
+  processor.setPlayHead(&playHead);
+  processor.setPlayConfigDetails(0, settings.numChannels, settings.sampleRate,
+                                 settings.blockSize);
+  processor.prepareToPlay(settings.sampleRate, settings.blockSize);
+
+  RenderResult result{
+    AudioBuffer<float>(settings.numChannels, static_cast<int>(totalSamples)), 0, 0, 0};
+  AudioBuffer<float> block(settings.numChannels, settings.blockSize);
+  MidiBuffer midiBuffer;
+
+  for (int64 start = 0; start < totalSamples; start += settings.blockSize)
+  {
+    const int numSamples =
+      static_cast<int>(std::min<int64>(settings.blockSize, totalSamples - start));
+    block.setSize(settings.numChannels, numSamples, false, false, true);
+
+    midiBuffer.clear();
+    for (const MidiEvent& event : settings.midi)
+    {
+      const int64 time = static_cast<int64>(event.beat * samplesPerBeat);
+      if (time >= start && time < start + numSamples)
+      {
+        const MidiMessage message = event.on
+                                      ? MidiMessage::noteOn(1, event.note, uint8(100))
+                                      : MidiMessage::noteOff(1, event.note);
+        midiBuffer.addEvent(message, static_cast<int>(time - start));
+      }
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    processor.processBlock(block, midiBuffer);
+    const auto end = std::chrono::steady_clock::now();
+
+    const double seconds = std::chrono::duration<double>(end - begin).count();
+    result.totalSeconds += seconds;
+    result.worstBlockSeconds = std::max(result.worstBlockSeconds, seconds);
+    ++result.numBlocks;
+
+    for (int channel = 0; channel < settings.numChannels; ++channel)
+    {
+      result.audio.copyFrom(channel, static_cast<int>(start), block, channel, 0,
+                            numSamples);
+    }
+    playHead.advance(numSamples);
+  }
+
+  processor.releaseResources();
+  processor.setPlayHead(nullptr);
+  return result;
+}
+
+bool writeWav(const File& file, const AudioBuffer<float>& audio, const double sampleRate)
+{
+  file.deleteFile();
+  ScopedPointer<FileOutputStream> stream(file.createOutputStream());
+  if (!stream)
+  {
+    return false;
+  }
+
+  WavAudioFormat format;
+  ScopedPointer<AudioFormatWriter> writer(
+    format.createWriterFor(stream, sampleRate,
+                           static_cast<unsigned int>(audio.getNumChannels()), 24, {}, 0));
+  if (!writer)
+  {
+    return false;
+  }
+  stream.release();
+
+  return writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples());
+}
+
+RenderSettings triggerSettings(const RenderSettings& settings, const int numTriggers)
+{
+  const double samplesPerBeat = settings.sampleRate * 60. / settings.bpm;
+  // a whole number of blocks, so that the offset into the block is up to the triggers
+  const int64 spacing =
+    settings.blockSize
+    * static_cast<int64>(ceil(samplesPerBeat / 2. / settings.blockSize));
+
+  RenderSettings result = settings;
+  result.midi.clear();
+  for (int i = 0; i < numTriggers; ++i)
+  {
+    const int64 time = i * spacing + (i * 97) % settings.blockSize;
+    result.midi.push_back({time / samplesPerBeat, 60, true});
+    result.midi.push_back({(time + spacing / 2) / samplesPerBeat, 60, false});
+  }
+  result.numBars =
+    static_cast<int>(numTriggers * spacing / (samplesPerBeat * beatsPerBar)) + 1;
+  return result;
+}
+
+int64 maxTriggerLatency(const RenderSettings& settings, const AudioBuffer<float>& audio)
+{
+  const double samplesPerBeat = settings.sampleRate * 60. / settings.bpm;
+  const int64 numSamples = audio.getNumSamples();
+  int64 latency = 0;
+
+  for (std::size_t i = 0; i < settings.midi.size(); ++i)
+  {
+    if (!settings.midi[i].on)
+    {
+      continue;
+    }
+
+    // the same rounding render() places events with
+    const int64 time = static_cast<int64>(settings.midi[i].beat * samplesPerBeat);
+    const int64 limit =
+      i + 1 < settings.midi.size()
+        ? static_cast<int64>(settings.midi[i + 1].beat * samplesPerBeat)
+        : numSamples;
+
+    int64 sample = time;
+    for (; sample < std::min(limit, numSamples); ++sample)
+    {
+      const int index = static_cast<int>(sample);
+      bool sounds = false;
+      for (int channel = 0; channel < audio.getNumChannels(); ++channel)
+      {
+        sounds = sounds || audio.getSample(channel, index) != 0;
+      }
+      if (sounds)
+      {
+        break;
+      }
+    }
+    latency = std::max(latency, sample - time);
+  }
+
+  return latency;
+}
+
+bool writeTestTone(const File& file, const double sampleRate)
+{
+  AudioBuffer<float> tone(1, static_cast<int>(sampleRate));
+  for (int i = 0; i < tone.getNumSamples(); ++i)
+  {
+    tone.setSample(0, i, 0.5f);
+  }
+  return writeWav(file, tone, sampleRate);
+}
+
+} // namespace tools
+} // namespace breakov
+
+POP_WARNINGS
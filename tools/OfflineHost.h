@@ -0,0 +1,100 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../src/PluginProcessor.h"
+#include "../src/Warnings.h"
+#include <vector>
+
+PUSH_WARNINGS
+
+namespace breakov
+{
+namespace tools
+{
+const static int beatsPerBar = 4;
+
+struct OfflinePlayHead : public AudioPlayHead
+{
+  OfflinePlayHead(double bpm, double ppq, bool playing, double sampleRate);
+
+  bool getCurrentPosition(CurrentPositionInfo& result) override;
+  void advance(int numSamples);
+
+  double mBpm;
+  double mPpq;
+  bool mPlaying;
+  double mSampleRate;
+  int64 mTimeInSamples;
+};
+
+struct MidiEvent
+{
+  double beat;
+  int note;
+  bool on;
+};
+
+// the argument following an option, or the fallback if the option isn't given
+String option(const StringArray& args, const String& name, const String& fallback);
+
+// "beat:note:on|off" entries separated by commas, e.g. "0:60:on,16:60:off"
+std::vector<MidiEvent> parseMidiScript(const String& script);
+
+struct RenderSettings
+{
+  RenderSettings();
+
+  double bpm;
+  double ppq;
+  bool playing;
+  double sampleRate;
+  int numChannels;
+  int numBars;
+  int blockSize;
+  std::vector<MidiEvent> midi;
+};
+
+struct RenderResult
+{
+  AudioBuffer<float> audio;
+  int numBlocks;
+  double totalSeconds;
+  double worstBlockSeconds;
+};
+
+int64 numSamplesToRender(const RenderSettings& settings);
+RenderResult render(Processor& processor, const RenderSettings& settings);
+bool writeWav(const File& file, const AudioBuffer<float>& audio, double sampleRate);
+
+// Settings with note-ons at a different offset into the block each, every one released
+// before the next.
+RenderSettings triggerSettings(const RenderSettings& settings, int numTriggers);
+
+// Longest time in samples from a scripted note-on to the first sample it sounds on. The
+// source must not contain silence, like the one written by writeTestTone.
+int64 maxTriggerLatency(const RenderSettings& settings, const AudioBuffer<float>& audio);
+
+// a second of a constant signal
+bool writeTestTone(const File& file, double sampleRate);
+
+} // namespace tools
+} // namespace breakov
+
+POP_WARNINGS
@@ -0,0 +1,50 @@
+# The processor sources and the offline host the console tools in tools/ build with, as
+# arguments of jucer_project_files. The paths are relative to the tool directories.
+
+set(breakov_tool_files
+# Compile   Xcode     Binary
+#           Resource  Resource
+  .         .         .         "../../src/Warnings.h"
+  x         .         .         "../../src/PluginProcessor.cpp"
+  .         .         .         "../../src/PluginProcessor.h"
+  x         .         .         "../../src/PluginEditor.cpp"
+  .         .         .         "../../src/PluginEditor.h"
+  .         .         .         "../../src/AliasTable.h"
+  .         .         .         "../../src/TripleBuffer.h"
+  .         .         .         "../../src/Rcu.h"
+  .         .         .         "../../src/Warps.h"
+  .         .         .         "../../src/Render.h"
+  x         .         .         "../../src/Render.cpp"
+  .         .         .         "../../src/SampleSource.h"
+  x         .         .         "../../src/SampleSource.cpp"
+  .         .         .         "../../src/FileLoader.h"
+  x         .         .         "../../src/FileLoader.cpp"
+  .         .         .         "../../src/PeakCache.h"
+  x         .         .         "../../src/PeakCache.cpp"
+  .         .         .         "../../src/AudioCodec.h"
+  x         .         .         "../../src/AudioCodec.cpp"
+  .         .         .         "../../src/Resampler.h"
+  x         .         .         "../../src/Resampler.cpp"
+  .         .         .         "../../src/ProbabilityMatrix.h"
+  .         .         .         "../../src/SparseAliasTable.h"
+  x         .         .         "../../src/SparseAliasTable.cpp"
+  .         .         .         "../../src/SparseChain.h"
+  x         .         .         "../../src/SparseChain.cpp"
+  x         .         .         "../../src/ContextChain.cpp"
+  .         .         .         "../../src/ContextChain.h"
+  x         .         .         "../../src/ContextTable.cpp"
+  .         .         .         "../../src/ContextTable.h"
+  x         .         .         "../../src/Onsets.cpp"
+  .         .         .         "../../src/Onsets.h"
+  x         .         .         "../../src/ZeroCrossings.cpp"
+  .         .         .         "../../src/ZeroCrossings.h"
+  x         .         .         "../../src/MarkovPath.cpp"
+  .         .         .         "../../src/MarkovPath.h"
+  .         .         .         "../../src/Random.h"
+  x         .         .         "../../src/BlockStats.cpp"
+  .         .         .         "../../src/BlockStats.h"
+  .         .         .         "../../src/Workers.h"
+  x         .         .         "../../src/Workers.cpp"
+  x         .         .         "../OfflineHost.cpp"
+  .         .         .         "../OfflineHost.h"
+)
@@ -0,0 +1,243 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../src/Onsets.h"
+#include "../../src/PluginProcessor.h"
+#include "../../src/Resampler.h"
+#include "../../src/Warnings.h"
+#include "../OfflineHost.h"
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+PUSH_WARNINGS
+
+using namespace breakov;
+
+namespace
+{
+void printUsage()
+{
+  std::cout
+    << "usage: breakov-bench --file <audio file> [options]\n"
+       "  --bpm <bpm>          host tempo (120)\n"
+       "  --ppq <beats>        host position at the start of the render (0)\n"
+       "  --stopped            report the transport as stopped\n"
+       "  --rate <hz>          host sample rate (48000)\n"
+       "  --bars <n>           number of 4/4 bars to render per block size (8)\n"
+       "  --blocks <a,b,..>    block sizes (16,32,64,128,256,512,1024,2048,4096)\n"
+       "  --midi <script>      beat:note:on|off,... (0:60:on)\n"
+       "  --quality <a,b,..>   interpolations to render with (linear,hermite,sinc)\n"
+       "  --out <file.wav>     write the render of the first block size and quality\n"
+       "  --latency            also measure the worst note-on latency in samples\n"
+       "  --resampler          measure the sample rate conversion instead, no file\n"
+       "  --onsets             time the onset detection instead, no file\n";
+}
+
+// The worst error of tones converted between common rates against the same tones
+// computed at the new rate, away from the ends where the kernel runs out of input.
+void measureResampler()
+{
+  const std::array<std::array<double, 2>, 4> rates{
+    {{{44100, 48000}}, {{48000, 44100}}, {{44100, 96000}}, {{96000, 44100}}}};
+  const std::array<double, 5> tones{{100, 1000, 5000, 15000, 19000}};
+  const float amplitude = 0.5f;
+
+  std::cout << "from\tto\ttone\terror dB\n";
+  for (const auto& rate : rates)
+  {
+    for (const double tone : tones)
+    {
+      AudioBuffer<float> input(1, static_cast<int>(rate[0]));
+      for (int i = 0; i < input.getNumSamples(); ++i)
+      {
+        const double phase = 2 * double_Pi * tone * i / rate[0];
+        input.setSample(0, i, amplitude * static_cast<float>(sin(phase)));
+      }
+
+      AudioBuffer<float> output;
+      resample(input, rate[0], rate[1], output);
+      const int numSamples = output.getNumSamples();
+      double worst = 0;
+      for (int i = numSamples / 4; i < numSamples * 3 / 4; ++i)
+      {
+        const double expected = amplitude * sin(2 * double_Pi * tone * i / rate[1]);
+        worst = std::max(worst, std::abs(output.getSample(0, i) - expected));
+      }
+      std::cout << rate[0] << "\t" << rate[1] << "\t" << tone << "\t"
+                << 20 * log10(worst / amplitude) << "\n";
+    }
+  }
+}
+
+// The time the onsets of ten minutes of stereo at 48 kHz take to detect, the best of a
+// few runs. The audio is noise in bursts that die away, two a second.
+void measureOnsets()
+{
+  const double sampleRate = 48000;
+  const int numSamples = static_cast<int>(600 * sampleRate);
+  const int burstLength = static_cast<int>(sampleRate / 2);
+  AudioBuffer<float> buffer(2, numSamples);
+  Random random(1);
+  for (int i = 0; i < numSamples; ++i)
+  {
+    const float envelope = static_cast<float>(exp(-(i % burstLength) / 2000.));
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+    {
+      buffer.setSample(channel, i, envelope * (2 * random.nextFloat() - 1));
+    }
+  }
+  const auto source = makeMemorySource(std::move(buffer), sampleRate);
+
+  double best = 0;
+  std::size_t numOnsets = 0;
+  for (int run = 0; run < 3; ++run)
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto onsets = detectOnsets(*source);
+    const auto end = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(end - begin).count();
+    best = run == 0 ? seconds : std::min(best, seconds);
+    numOnsets = onsets ? onsets->size() : 0;
+  }
+  std::cout << "600 s of stereo at 48 kHz, " << numOnsets << " onsets in " << best
+            << " s on " << SystemStats::getNumCpus() << " cores\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  const StringArray args(argv + 1, argc - 1);
+  if (args.contains("--resampler"))
+  {
+    measureResampler();
+    return 0;
+  }
+  if (args.contains("--onsets"))
+  {
+    measureOnsets();
+    return 0;
+  }
+
+  const File file = File::getCurrentWorkingDirectory().getChildFile(
+    tools::option(args, "--file", String()));
+
+  if (args.contains("--help") || !file.existsAsFile())
+  {
+    printUsage();
+    return 1;
+  }
+
+  tools::RenderSettings settings;
+  settings.bpm = tools::option(args, "--bpm", "120").getDoubleValue();
+  settings.ppq = tools::option(args, "--ppq", "0").getDoubleValue();
+  settings.playing = !args.contains("--stopped");
+  settings.sampleRate = tools::option(args, "--rate", "48000").getDoubleValue();
+  settings.numBars = tools::option(args, "--bars", "8").getIntValue();
+  settings.midi = tools::parseMidiScript(tools::option(args, "--midi", "0:60:on"));
+
+  const StringArray blockSizes = StringArray::fromTokens(
+    tools::option(args, "--blocks", "16,32,64,128,256,512,1024,2048,4096"), ",", "");
+  const StringArray qualities = StringArray::fromTokens(
+    tools::option(args, "--quality", "linear,hermite,sinc"), ",", "");
+  const String out = tools::option(args, "--out", String());
+  const bool measureLatency = args.contains("--latency");
+
+  const File tone = File::createTempFile(".wav");
+  if (measureLatency && !tools::writeTestTone(tone, settings.sampleRate))
+  {
+    std::cerr << "could not write " << tone.getFullPathName() << "\n";
+    return 1;
+  }
+
+  std::cout << "file: " << file.getFullPathName() << "\n"
+            << "bpm: " << settings.bpm << ", rate: " << settings.sampleRate
+            << ", bars: " << settings.numBars
+            << ", transport: " << (settings.playing ? "playing" : "stopped") << "\n\n"
+            << "block\tquality\tns/sample\tblocks/s\tworst us\tbudget us"
+            << (measureLatency ? "\tlatency" : "") << "\n";
+
+  bool isFirstRender = true;
+  for (int i = 0; i < blockSizes.size(); ++i)
+  {
+    settings.blockSize = blockSizes[i].getIntValue();
+    if (settings.blockSize <= 0)
+    {
+      continue;
+    }
+
+    for (int q = 0; q < qualities.size(); ++q)
+    {
+      const int quality = interpolationNames().indexOf(qualities[q]);
+      if (quality < 0)
+      {
+        continue;
+      }
+
+      // the file is converted to the render rate while it is opened
+      Processor processor;
+      processor.setRateAndBufferSizeDetails(settings.sampleRate, settings.blockSize);
+      processor.openFile(file);
+      *processor.mParameters.getRawParameterValue("quality") =
+        static_cast<float>(quality);
+
+      const tools::RenderResult result = tools::render(processor, settings);
+      const double numSamples = static_cast<double>(result.audio.getNumSamples());
+      const double budget = settings.blockSize / settings.sampleRate;
+
+      std::cout << settings.blockSize << "\t" << qualities[q] << "\t"
+                << result.totalSeconds / numSamples * 1e9 << "\t"
+                << result.numBlocks / result.totalSeconds << "\t"
+                << result.worstBlockSeconds * 1e6 << "\t" << budget * 1e6;
+
+      if (measureLatency)
+      {
+        Processor triggered;
+        triggered.setRateAndBufferSizeDetails(settings.sampleRate, settings.blockSize);
+        triggered.openFile(tone);
+        *triggered.mParameters.getRawParameterValue("quality") =
+          static_cast<float>(quality);
+        const tools::RenderSettings trigger = tools::triggerSettings(settings, 32);
+        const tools::RenderResult triggerResult = tools::render(triggered, trigger);
+        std::cout << "\t" << tools::maxTriggerLatency(trigger, triggerResult.audio);
+      }
+      std::cout << "\n";
+
+      // only the first render is written, the others are only timed
+      if (isFirstRender && out.isNotEmpty())
+      {
+        const File outFile = File::getCurrentWorkingDirectory().getChildFile(out);
+        if (!tools::writeWav(outFile, result.audio, settings.sampleRate))
+        {
+          std::cerr << "could not write " << outFile.getFullPathName() << "\n";
+          return 1;
+        }
+      }
+      isFirstRender = false;
+    }
+  }
+
+  tone.deleteFile();
+  return 0;
+}
+
+POP_WARNINGS
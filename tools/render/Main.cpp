@@ -0,0 +1,346 @@
+/* breakov
+ * Copyright (C) 2017 Florian Goltz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../../src/PluginProcessor.h"
+#include "../../src/Warnings.h"
+#include "../OfflineHost.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+PUSH_WARNINGS
+
+using namespace breakov;
+
+namespace
+{
+void printUsage()
+{
+  std::cout
+    << "usage: breakov-render [options] <audio file> ...\n"
+       "  --list <file>        also render the files listed, one path per line\n"
+       "  --preset <file>      plug-in state to render with (the default state)\n"
+       "  --out-dir <dir>      where the renders are written (.)\n"
+       "  --variations <n>     renders per file, each with its own seed (1)\n"
+       "  --seed <n>           seed of the first render, the others count up (0)\n"
+       "  --record             write the path each render took next to it\n"
+       "  --replay <file>      take the slices and warps from a recorded path\n"
+       "  --threads <n>        number of renders at a time (number of cores)\n"
+       "  --bpm <bpm>          host tempo (120)\n"
+       "  --ppq <beats>        host position at the start of the render (0)\n"
+       "  --stopped            report the transport as stopped\n"
+       "  --rate <hz>          host sample rate (48000)\n"
+       "  --bars <n>           number of 4/4 bars to render (8)\n"
+       "  --block <n>          block size (512)\n"
+       "  --midi <script>      beat:note:on|off,... (0:60:on)\n";
+}
+
+// the arguments that are neither options nor the values of options
+StringArray inputPaths(const StringArray& args)
+{
+  const StringArray flags{"--stopped", "--record", "--help"};
+  StringArray paths;
+  for (int i = 0; i < args.size(); ++i)
+  {
+    if (!args[i].startsWith("--"))
+    {
+      paths.add(args[i]);
+    }
+    else if (!flags.contains(args[i]))
+    {
+      ++i;
+    }
+  }
+  return paths;
+}
+
+// The name of the renders of an input, with a number appended if an input before it had
+// the same name, so that files of the same name in different folders keep their renders.
+String outputName(const File& input, StringArray& names)
+{
+  const String base = input.getFileNameWithoutExtension();
+  String name = base;
+  for (int i = 2; names.contains(name, true); ++i)
+  {
+    name = base + "_" + String(i);
+  }
+  names.add(name);
+  return name;
+}
+
+struct Job
+{
+  File input;
+  File output;
+  int seed;
+};
+
+// A thread with a processor of its own. Workers take the next job whenever they finish
+// one, so that none stays idle while jobs are left, however long each takes.
+class RenderWorker : public Thread
+{
+public:
+  RenderWorker(const std::vector<Job>& jobs,
+               std::atomic<std::size_t>& nextJob,
+               const MemoryBlock& preset,
+               std::shared_ptr<const MarkovPath> replay,
+               bool record,
+               const tools::RenderSettings& settings,
+               std::mutex& outputMutex);
+  ~RenderWorker();
+
+  void run() override;
+
+  int64 mNumRendered;
+  int mNumFailed;
+
+private:
+  bool renderJob(const Job& job);
+
+  const std::vector<Job>& mJobs;
+  std::atomic<std::size_t>& mNextJob;
+  const bool mRecord;
+  const tools::RenderSettings& mSettings;
+  std::mutex& mOutputMutex;
+  Processor mProcessor;
+};
+
+RenderWorker::RenderWorker(const std::vector<Job>& jobs,
+                           std::atomic<std::size_t>& nextJob,
+                           const MemoryBlock& preset,
+                           std::shared_ptr<const MarkovPath> replay,
+                           const bool record,
+                           const tools::RenderSettings& settings,
+                           std::mutex& outputMutex)
+  : Thread("breakov render")
+  , mNumRendered(0)
+  , mNumFailed(0)
+  , mJobs(jobs)
+  , mNextJob(nextJob)
+  , mRecord(record)
+  , mSettings(settings)
+  , mOutputMutex(outputMutex)
+{
+  // the chains and parameters stay as they are for all jobs, only the file changes
+  if (preset.getSize() > 0)
+  {
+    mProcessor.setStateInformation(preset.getData(), static_cast<int>(preset.getSize()));
+    mProcessor.cancelLoading();
+  }
+  mProcessor.replayPath(std::move(replay));
+  // files are converted to the render rate while they are opened
+  mProcessor.setRateAndBufferSizeDetails(settings.sampleRate, settings.blockSize);
+}
+
+RenderWorker::~RenderWorker()
+{
+  stopThread(-1);
+}
+
+void RenderWorker::run()
+{
+  for (std::size_t job = mNextJob++; job < mJobs.size() && !threadShouldExit();
+       job = mNextJob++)
+  {
+    if (!renderJob(mJobs[job]))
+    {
+      ++mNumFailed;
+    }
+  }
+}
+
+bool RenderWorker::renderJob(const Job& job)
+{
+  const auto begin = std::chrono::steady_clock::now();
+
+  if (!mProcessor.openFile(job.input))
+  {
+    std::lock_guard<std::mutex> lock(mOutputMutex);
+    std::cerr << "could not open " << job.input.getFullPathName() << "\n";
+    return false;
+  }
+
+  // the generator is seeded as the render starts
+  *mProcessor.mParameters.getRawParameterValue("seed") = static_cast<float>(job.seed);
+  const tools::RenderResult result = tools::render(mProcessor, mSettings);
+  if (!tools::writeWav(job.output, result.audio, mSettings.sampleRate))
+  {
+    std::lock_guard<std::mutex> lock(mOutputMutex);
+    std::cerr << "could not write " << job.output.getFullPathName() << "\n";
+    return false;
+  }
+
+  if (mRecord)
+  {
+    const File pathFile = job.output.withFileExtension("path");
+    pathFile.deleteFile();
+    FileOutputStream stream(pathFile);
+    if (!stream.openedOk())
+    {
+      std::lock_guard<std::mutex> lock(mOutputMutex);
+      std::cerr << "could not write " << pathFile.getFullPathName() << "\n";
+      return false;
+    }
+    writePath(mProcessor.getRecordedPath(), stream);
+  }
+
+  const auto end = std::chrono::steady_clock::now();
+  const double seconds = std::chrono::duration<double>(end - begin).count();
+  const double audioSeconds = result.audio.getNumSamples() / mSettings.sampleRate;
+  mNumRendered += result.audio.getNumSamples();
+
+  std::lock_guard<std::mutex> lock(mOutputMutex);
+  std::cout << job.output.getFileName() << "\tseed " << job.seed << "\t"
+            << audioSeconds / seconds << "x realtime\n";
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+  ScopedJuceInitialiser_GUI juce;
+
+  const StringArray args(argv + 1, argc - 1);
+  const File directory = File::getCurrentWorkingDirectory();
+
+  StringArray paths = inputPaths(args);
+  const String list = tools::option(args, "--list", String());
+  if (list.isNotEmpty())
+  {
+    for (const String& line :
+         StringArray::fromLines(directory.getChildFile(list).loadFileAsString()))
+    {
+      if (line.trim().isNotEmpty())
+      {
+        paths.add(line.trim());
+      }
+    }
+  }
+
+  if (args.contains("--help") || paths.isEmpty())
+  {
+    printUsage();
+    return 1;
+  }
+
+  tools::RenderSettings settings;
+  settings.bpm = tools::option(args, "--bpm", "120").getDoubleValue();
+  settings.ppq = tools::option(args, "--ppq", "0").getDoubleValue();
+  settings.playing = !args.contains("--stopped");
+  settings.sampleRate = tools::option(args, "--rate", "48000").getDoubleValue();
+  settings.numBars = tools::option(args, "--bars", "8").getIntValue();
+  settings.blockSize = std::max(1, tools::option(args, "--block", "512").getIntValue());
+  settings.midi = tools::parseMidiScript(tools::option(args, "--midi", "0:60:on"));
+
+  MemoryBlock preset;
+  const String presetPath = tools::option(args, "--preset", String());
+  if (presetPath.isNotEmpty()
+      && !directory.getChildFile(presetPath).loadFileAsData(preset))
+  {
+    std::cerr << "could not read " << presetPath << "\n";
+    return 1;
+  }
+
+  std::shared_ptr<const MarkovPath> replay;
+  const String replayPath = tools::option(args, "--replay", String());
+  if (replayPath.isNotEmpty())
+  {
+    FileInputStream stream(directory.getChildFile(replayPath));
+    if (!stream.openedOk())
+    {
+      std::cerr << "could not read " << replayPath << "\n";
+      return 1;
+    }
+    replay = std::make_shared<const MarkovPath>(readPath(stream));
+  }
+  const bool record = args.contains("--record");
+
+  const File outDir = directory.getChildFile(tools::option(args, "--out-dir", "."));
+  if (!outDir.createDirectory())
+  {
+    std::cerr << "could not create " << outDir.getFullPathName() << "\n";
+    return 1;
+  }
+
+  const int numVariations =
+    std::max(1, tools::option(args, "--variations", "1").getIntValue());
+  const int seed = jlimit(0, maxSeed, tools::option(args, "--seed", "0").getIntValue());
+  std::vector<Job> jobs;
+  StringArray names;
+  for (const String& path : paths)
+  {
+    const File input = directory.getChildFile(path);
+    const String name = outputName(input, names);
+    for (int variation = 0; variation < numVariations; ++variation)
+    {
+      const String suffix = numVariations > 1 ? "-" + String(variation + 1) : String();
+      const File output = outDir.getChildFile(name + suffix + ".wav");
+      if (output == input)
+      {
+        std::cerr << "would overwrite " << input.getFullPathName() << "\n";
+        return 1;
+      }
+      const int jobSeed = (seed + static_cast<int>(jobs.size())) % (maxSeed + 1);
+      jobs.push_back({input, output, jobSeed});
+    }
+  }
+
+  const String cores(SystemStats::getNumCpus());
+  const int numThreads = jlimit(1, static_cast<int>(jobs.size()),
+                                tools::option(args, "--threads", cores).getIntValue());
+
+  std::atomic<std::size_t> nextJob(0);
+  std::mutex outputMutex;
+  std::vector<std::unique_ptr<RenderWorker>> workers;
+  for (int i = 0; i < numThreads; ++i)
+  {
+    workers.emplace_back(
+      new RenderWorker(jobs, nextJob, preset, replay, record, settings, outputMutex));
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  for (auto& worker : workers)
+  {
+    worker->startThread();
+  }
+  int64 numRendered = 0;
+  int numFailed = 0;
+  for (auto& worker : workers)
+  {
+    worker->waitForThreadToExit(-1);
+    numRendered += worker->mNumRendered;
+    numFailed += worker->mNumFailed;
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  // the wall clock time of the whole run, loading and writing included
+  const double seconds = std::chrono::duration<double>(end - begin).count();
+  const double audioSeconds = static_cast<double>(numRendered) / settings.sampleRate;
+  std::cout << "\n"
+            << jobs.size() - static_cast<std::size_t>(numFailed) << " of " << jobs.size()
+            << " jobs on " << numThreads << " threads, " << audioSeconds << " s in "
+            << seconds << " s: " << audioSeconds / seconds << "x realtime\n";
+
+  return numFailed > 0 ? 1 : 0;
+}
+
+POP_WARNINGS